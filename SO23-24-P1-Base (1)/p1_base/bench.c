@@ -0,0 +1,252 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "operations.h"
+
+// Runs K independent EMS instances on K threads, for K from 1 up to the given maximum, and reports
+// the total throughput. Instances share no state, so the throughput should grow linearly with K
+// until the threads outnumber the cores.
+//
+// With --churn, threads instead interleave RESERVE and CANCEL on one hot event, keeping a window of
+// live reservations, and the peak memory shows whether it follows the live reservations or every
+// reservation ever made.
+
+#define BENCH_ROWS 1000
+#define BENCH_COLS 1000
+#define BENCH_CANCEL_EVERY 16
+#define BENCH_SHOW_EVERY 4096
+#define CHURN_LIVE_RESERVATIONS 64
+#define CHURN_COLS (1 << 16)  // Wide enough that a seat is only reused long after it was cancelled.
+#define MAX_CHURN_SEATS 16
+
+struct Worker {
+  pthread_t thread;
+  unsigned int delay_ms;
+  size_t num_ops;
+  size_t output_bytes;
+  int result;
+};
+
+static int count_output(void *context, const char *data, size_t length) {
+  (void)data;
+  *(size_t *)context += length;
+  return 0;
+}
+
+static double now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
+
+/// Books the seats of one event one at a time, cancelling some of the reservations and printing
+/// the event now and then, on an instance of its own.
+static void *worker_main(void *arg) {
+  struct Worker *worker = arg;
+  struct ems_options options = {worker->delay_ms, 0, 0, NULL};
+  struct ems_output out = {count_output, &worker->output_bytes, 1};
+
+  struct ems_instance *ems = ems_init(&options);
+  if (ems == NULL || ems_create(ems, 1, BENCH_ROWS, BENCH_COLS) != 0) {
+    worker->result = 1;
+    ems_terminate(ems);
+    return NULL;
+  }
+
+  unsigned int reservation_id = 0;
+  for (size_t i = 0; i < worker->num_ops && worker->result == 0; i++) {
+    size_t seat = i % (BENCH_ROWS * BENCH_COLS);
+    size_t xs[1] = {seat / BENCH_COLS + 1};
+    size_t ys[1] = {seat % BENCH_COLS + 1};
+
+    if (i > 0 && seat == 0) {
+      // Every seat is taken, so the event is started over.
+      ems_terminate(ems);
+      ems = ems_init(&options);
+      reservation_id = 0;
+      worker->result = ems == NULL || ems_create(ems, 1, BENCH_ROWS, BENCH_COLS) != 0;
+      continue;
+    }
+
+    worker->result |= ems_reserve(ems, 1, 1, xs, ys);
+    reservation_id++;
+
+    if (i % BENCH_CANCEL_EVERY == 0) {
+      worker->result |= ems_cancel(ems, 1, reservation_id);
+    }
+
+    if (i % BENCH_SHOW_EVERY == 0) {
+      worker->result |= ems_show(ems, 1, &out);
+    }
+  }
+
+  ems_terminate(ems);
+  return NULL;
+}
+
+struct ChurnWorker {
+  pthread_t thread;
+  struct ems_instance *ems;
+  size_t row;                   /// Row of the hot event whose seats the worker reserves.
+  size_t num_ops;
+  size_t seats_per_reservation;
+  atomic_uint *made;            /// Number of reservations made by every worker.
+  size_t failed;
+};
+
+/// Reserves the seats of its own row in turn, and after each reservation cancels the one made
+/// CHURN_LIVE_RESERVATIONS reservations earlier by any worker.
+static void *churn_main(void *arg) {
+  struct ChurnWorker *worker = arg;
+  size_t xs[MAX_CHURN_SEATS], ys[MAX_CHURN_SEATS];
+  size_t col = 0;
+
+  for (size_t i = 0; i < worker->num_ops; i++) {
+    for (size_t j = 0; j < worker->seats_per_reservation; j++) {
+      xs[j] = worker->row;
+      ys[j] = col + 1;
+      col = (col + 1) % CHURN_COLS;
+    }
+
+    if (ems_reserve(worker->ems, 1, worker->seats_per_reservation, xs, ys) != 0) {
+      worker->failed++;
+      continue;
+    }
+
+    unsigned int made = atomic_fetch_add(worker->made, 1) + 1;
+    if (made > CHURN_LIVE_RESERVATIONS && ems_cancel(worker->ems, 1, made - CHURN_LIVE_RESERVATIONS) != 0) {
+      worker->failed++;
+    }
+  }
+
+  return NULL;
+}
+
+static int churn(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s --churn <threads> [ops_per_thread] [seats_per_reservation]\n", argv[0]);
+    return 1;
+  }
+
+  unsigned int num_threads = (unsigned int)strtoul(argv[1], NULL, 10);
+  size_t num_ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+  size_t seats = argc > 3 ? strtoul(argv[3], NULL, 10) : 4;
+  if (num_threads == 0 || seats == 0 || seats > MAX_CHURN_SEATS) {
+    fprintf(stderr, "Invalid churn parameters\n");
+    return 1;
+  }
+
+  struct ems_options options = {0, 0, 0, NULL};
+  struct ems_instance *ems = ems_init(&options);
+  struct ChurnWorker *workers = malloc(num_threads * sizeof(struct ChurnWorker));
+  if (ems == NULL || workers == NULL || ems_create(ems, 1, num_threads, CHURN_COLS) != 0) {
+    fprintf(stderr, "Failed to set up the hot event\n");
+    ems_terminate(ems);
+    free(workers);
+    return 1;
+  }
+
+  atomic_uint made = 0;
+  double start = now();
+
+  unsigned int started = 0;
+  for (; started < num_threads; started++) {
+    workers[started] = (struct ChurnWorker){0, ems, started + 1, num_ops, seats, &made, 0};
+    if (pthread_create(&workers[started].thread, NULL, churn_main, &workers[started]) != 0) {
+      fprintf(stderr, "Failed to create worker thread\n");
+      break;
+    }
+  }
+
+  size_t failed = 0;
+  for (unsigned int i = 0; i < started; i++) {
+    pthread_join(workers[i].thread, NULL);
+    failed += workers[i].failed;
+  }
+
+  double seconds = now() - start;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  // ru_maxrss is in kilobytes, except on macOS where it is in bytes.
+#ifdef __APPLE__
+  usage.ru_maxrss /= 1024;
+#endif
+
+  printf("threads  seconds  ops/s       failed  peak RSS\n");
+  printf("%7u  %7.3f  %-10.0f  %6zu  %5ld MiB\n", started, seconds,
+         2.0 * (double)started * (double)num_ops / seconds, failed, usage.ru_maxrss / 1024);
+
+  ems_terminate(ems);
+  free(workers);
+  return started < num_threads;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--churn") == 0) {
+    argv[1] = argv[0];
+    return churn(argc - 1, argv + 1);
+  }
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <max_instances> [ops_per_instance] [state_access_delay_ms]\n", argv[0]);
+    fprintf(stderr, "       %s --churn <threads> [ops_per_thread] [seats_per_reservation]\n", argv[0]);
+    return 1;
+  }
+
+  unsigned int max_instances = (unsigned int)strtoul(argv[1], NULL, 10);
+  size_t num_ops = argc > 2 ? strtoul(argv[2], NULL, 10) : 200000;
+  unsigned int delay_ms = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 0;
+
+  struct Worker *workers = malloc(max_instances * sizeof(struct Worker));
+  if (workers == NULL) {
+    fprintf(stderr, "Error allocating memory for workers\n");
+    return 1;
+  }
+
+  printf("instances  seconds  ops/s       speedup  efficiency\n");
+
+  double base_rate = 0;
+  for (unsigned int count = 1; count <= max_instances; count++) {
+    double start = now();
+
+    unsigned int started = 0;
+    for (; started < count; started++) {
+      workers[started] = (struct Worker){0, delay_ms, num_ops, 0, 0};
+      if (pthread_create(&workers[started].thread, NULL, worker_main, &workers[started]) != 0) {
+        fprintf(stderr, "Failed to create worker thread\n");
+        break;
+      }
+    }
+
+    int ret = started < count;
+    for (unsigned int i = 0; i < started; i++) {
+      pthread_join(workers[i].thread, NULL);
+      ret |= workers[i].result;
+    }
+
+    double seconds = now() - start;
+
+    if (ret) {
+      fprintf(stderr, "Benchmark failed with %u instances\n", count);
+      free(workers);
+      return 1;
+    }
+
+    double rate = (double)count * (double)num_ops / seconds;
+    if (count == 1) {
+      base_rate = rate;
+    }
+
+    printf("%9u  %7.3f  %-10.0f  %7.2f  %9.0f%%\n", count, seconds, rate, rate / base_rate,
+           100.0 * rate / base_rate / count);
+  }
+
+  free(workers);
+  return 0;
+}
@@ -0,0 +1,435 @@
+#include "binformat.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+enum Opcode {
+  OP_CREATE = 1,
+  OP_RESERVE = 2,
+  OP_SHOW = 3,
+  OP_LIST_EVENTS = 4,
+  OP_WAIT = 5,
+  OP_BARRIER = 6,
+  OP_HELP = 7,
+  OP_CANCEL = 8,
+  OP_FORMAT = 9,
+  OP_BEGIN = 10,
+  OP_COMMIT = 11,
+};
+
+struct Decoder {
+  const unsigned char *pos;
+  const unsigned char *end;
+};
+
+static uint32_t adler32(const unsigned char *data, size_t len) {
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < len; i++) {
+    a = (a + data[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = read(fd, (char *)buf + done, len - done);
+    if (n <= 0) {
+      return 1;
+    }
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t n = write(fd, (const char *)buf + done, len - done);
+    if (n <= 0) {
+      return 1;
+    }
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+/// Reads the remainder of a record whose opcode was already consumed.
+/// @return 0 if the record was read and its checksum matches, 1 otherwise.
+static int read_record(int fd, unsigned char *payload, size_t *len) {
+  unsigned char header[BIN_RECORD_HEADER_SIZE - 1];
+  if (read_full(fd, header, sizeof(header)) != 0) {
+    return 1;
+  }
+
+  *len = (size_t)header[1] | (size_t)header[2] << 8;
+  uint32_t checksum = (uint32_t)header[3] | (uint32_t)header[4] << 8 | (uint32_t)header[5] << 16 |
+                      (uint32_t)header[6] << 24;
+
+  if (*len > BIN_MAX_PAYLOAD) {
+    lseek(fd, (off_t)*len, SEEK_CUR);
+    return 1;
+  }
+
+  if (read_full(fd, payload, *len) != 0) {
+    return 1;
+  }
+
+  return header[0] != 0 || adler32(payload, *len) != checksum;
+}
+
+static int read_varint(struct Decoder *decoder, unsigned int *value) {
+  unsigned long result = 0;
+  for (unsigned int shift = 0; shift < 35; shift += 7) {
+    if (decoder->pos == decoder->end) {
+      return 1;
+    }
+
+    unsigned char byte = *decoder->pos++;
+    result |= (unsigned long)(byte & 0x7F) << shift;
+
+    if ((byte & 0x80) == 0) {
+      if (result > UINT_MAX) {
+        return 1;
+      }
+
+      *value = (unsigned int)result;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void write_varint(unsigned char *buf, size_t *len, size_t value) {
+  while (value >= 0x80) {
+    buf[(*len)++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  buf[(*len)++] = (unsigned char)value;
+}
+
+static int write_record(int fd, enum Opcode opcode, const unsigned char *payload, size_t len) {
+  uint32_t checksum = adler32(payload, len);
+  unsigned char header[BIN_RECORD_HEADER_SIZE] = {
+      (unsigned char)opcode,          0,
+      (unsigned char)len,             (unsigned char)(len >> 8),
+      (unsigned char)checksum,        (unsigned char)(checksum >> 8),
+      (unsigned char)(checksum >> 16), (unsigned char)(checksum >> 24),
+  };
+
+  if (write_full(fd, header, sizeof(header)) != 0) {
+    return 1;
+  }
+
+  return write_full(fd, payload, len);
+}
+
+static enum Command bin_get_next(int fd) {
+  unsigned char opcode;
+  if (read(fd, &opcode, 1) != 1) {
+    return EOC;
+  }
+
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+
+  switch (opcode) {
+    case OP_CREATE:
+      return CMD_CREATE;
+
+    case OP_RESERVE:
+      return CMD_RESERVE;
+
+    case OP_CANCEL:
+      return CMD_CANCEL;
+
+    case OP_SHOW:
+      return CMD_SHOW;
+
+    case OP_FORMAT:
+      return CMD_FORMAT;
+
+    case OP_WAIT:
+      return CMD_WAIT;
+
+    case OP_LIST_EVENTS:
+      return read_record(fd, payload, &len) != 0 || len != 0 ? CMD_INVALID : CMD_LIST_EVENTS;
+
+    case OP_BARRIER:
+      return read_record(fd, payload, &len) != 0 || len != 0 ? CMD_INVALID : CMD_BARRIER;
+
+    case OP_HELP:
+      return read_record(fd, payload, &len) != 0 || len != 0 ? CMD_INVALID : CMD_HELP;
+
+    case OP_BEGIN:
+      return read_record(fd, payload, &len) != 0 || len != 0 ? CMD_INVALID : CMD_BEGIN;
+
+    case OP_COMMIT:
+      return read_record(fd, payload, &len) != 0 || len != 0 ? CMD_INVALID : CMD_COMMIT;
+
+    default:
+      read_record(fd, payload, &len);
+      return CMD_INVALID;
+  }
+}
+
+static int bin_parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return 1;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  unsigned int u_num_rows, u_num_cols;
+  if (read_varint(&decoder, event_id) != 0 || read_varint(&decoder, &u_num_rows) != 0 ||
+      read_varint(&decoder, &u_num_cols) != 0 || decoder.pos != decoder.end) {
+    return 1;
+  }
+
+  *num_rows = (size_t)u_num_rows;
+  *num_cols = (size_t)u_num_cols;
+
+  return 0;
+}
+
+static size_t bin_parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return 0;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  unsigned int num_coords;
+  if (read_varint(&decoder, event_id) != 0 || read_varint(&decoder, &num_coords) != 0 ||
+      num_coords >= max) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < num_coords; i++) {
+    unsigned int x, y;
+    if (read_varint(&decoder, &x) != 0 || read_varint(&decoder, &y) != 0) {
+      return 0;
+    }
+    xs[i] = (size_t)x;
+    ys[i] = (size_t)y;
+  }
+
+  if (decoder.pos != decoder.end) {
+    return 0;
+  }
+
+  return (size_t)num_coords;
+}
+
+static int bin_parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return 1;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  return read_varint(&decoder, event_id) != 0 || read_varint(&decoder, reservation_id) != 0 ||
+         decoder.pos != decoder.end;
+}
+
+static int bin_parse_show(int fd, unsigned int *event_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return 1;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  return read_varint(&decoder, event_id) != 0 || decoder.pos != decoder.end;
+}
+
+static int bin_parse_format(int fd, int *rle) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return 1;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  unsigned int value;
+  if (read_varint(&decoder, &value) != 0 || value > 1 || decoder.pos != decoder.end) {
+    return 1;
+  }
+
+  *rle = (int)value;
+  return 0;
+}
+
+static int bin_parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len;
+  if (read_record(fd, payload, &len) != 0) {
+    return -1;
+  }
+
+  struct Decoder decoder = {payload, payload + len};
+  unsigned int has_thread, id;
+  if (read_varint(&decoder, delay) != 0 || read_varint(&decoder, &has_thread) != 0 || has_thread > 1 ||
+      (has_thread && read_varint(&decoder, &id) != 0) || decoder.pos != decoder.end) {
+    return -1;
+  }
+
+  if (!has_thread || thread_id == NULL) {
+    return 0;
+  }
+
+  *thread_id = id;
+  return 1;
+}
+
+const struct CommandParser binary_parser = {
+    .get_next = bin_get_next,
+    .parse_create = bin_parse_create,
+    .parse_reserve = bin_parse_reserve,
+    .parse_cancel = bin_parse_cancel,
+    .parse_show = bin_parse_show,
+    .parse_format = bin_parse_format,
+    .parse_wait = bin_parse_wait,
+};
+
+static enum Command unsupported_get_next(int fd) {
+  (void)fd;
+  return EOC;
+}
+
+static const struct CommandParser unsupported_parser = {
+    .get_next = unsupported_get_next,
+};
+
+const struct CommandParser *detect_parser(int fd) {
+  unsigned char header[BIN_FILE_HEADER_SIZE];
+
+  if (read_full(fd, header, sizeof(header)) != 0 || memcmp(header, BIN_MAGIC, 4) != 0) {
+    lseek(fd, 0, SEEK_SET);
+    return &text_parser;
+  }
+
+  if (header[4] != BIN_VERSION) {
+    fprintf(stderr, "Unsupported binary job file version %u\n", header[4]);
+    return &unsupported_parser;
+  }
+
+  return &binary_parser;
+}
+
+int bin_write_header(int fd) {
+  unsigned char header[BIN_FILE_HEADER_SIZE] = {'E', 'M', 'S', 'B', BIN_VERSION, 0, 0, 0};
+  return write_full(fd, header, sizeof(header));
+}
+
+int bin_write_create(int fd, unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (num_rows > UINT_MAX || num_cols > UINT_MAX) {
+    return 1;
+  }
+
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, event_id);
+  write_varint(payload, &len, num_rows);
+  write_varint(payload, &len, num_cols);
+
+  return write_record(fd, OP_CREATE, payload, len);
+}
+
+int bin_write_reserve(int fd, unsigned int event_id, size_t num_coords, size_t *xs, size_t *ys) {
+  if (num_coords >= MAX_RESERVATION_SIZE) {
+    return 1;
+  }
+
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, event_id);
+  write_varint(payload, &len, num_coords);
+
+  for (size_t i = 0; i < num_coords; i++) {
+    if (xs[i] > UINT_MAX || ys[i] > UINT_MAX) {
+      return 1;
+    }
+
+    write_varint(payload, &len, xs[i]);
+    write_varint(payload, &len, ys[i]);
+  }
+
+  return write_record(fd, OP_RESERVE, payload, len);
+}
+
+int bin_write_cancel(int fd, unsigned int event_id, unsigned int reservation_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, event_id);
+  write_varint(payload, &len, reservation_id);
+
+  return write_record(fd, OP_CANCEL, payload, len);
+}
+
+int bin_write_show(int fd, unsigned int event_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, event_id);
+
+  return write_record(fd, OP_SHOW, payload, len);
+}
+
+int bin_write_format(int fd, int rle) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, rle != 0);
+
+  return write_record(fd, OP_FORMAT, payload, len);
+}
+
+int bin_write_wait(int fd, unsigned int delay, unsigned int *thread_id) {
+  unsigned char payload[BIN_MAX_PAYLOAD];
+  size_t len = 0;
+  write_varint(payload, &len, delay);
+  write_varint(payload, &len, thread_id != NULL);
+  if (thread_id != NULL) {
+    write_varint(payload, &len, *thread_id);
+  }
+
+  return write_record(fd, OP_WAIT, payload, len);
+}
+
+int bin_write_simple(int fd, enum Command cmd) {
+  switch (cmd) {
+    case CMD_LIST_EVENTS:
+      return write_record(fd, OP_LIST_EVENTS, NULL, 0);
+
+    case CMD_BARRIER:
+      return write_record(fd, OP_BARRIER, NULL, 0);
+
+    case CMD_HELP:
+      return write_record(fd, OP_HELP, NULL, 0);
+
+    case CMD_BEGIN:
+      return write_record(fd, OP_BEGIN, NULL, 0);
+
+    case CMD_COMMIT:
+      return write_record(fd, OP_COMMIT, NULL, 0);
+
+    case CMD_CREATE:
+    case CMD_RESERVE:
+    case CMD_CANCEL:
+    case CMD_SHOW:
+    case CMD_FORMAT:
+    case CMD_WAIT:
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+    default:
+      return 1;
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef EMS_BINFORMAT_H
+#define EMS_BINFORMAT_H
+
+#include <stddef.h>
+
+#include "constants.h"
+#include "parser.h"
+
+// Binary job files (.jobsb) start with an 8 byte file header:
+//   'E' 'M' 'S' 'B' <version> 0 0 0
+// followed by one record per command:
+//   <opcode:1> <flags:1> <payload length:2> <checksum:4> <payload>
+// Multi-byte header fields are little-endian, the checksum is the Adler-32 of the payload and
+// every payload field is an unsigned LEB128 varint.
+#define BIN_MAGIC "EMSB"
+#define BIN_VERSION 1
+#define BIN_FILE_HEADER_SIZE 8
+#define BIN_RECORD_HEADER_SIZE 8
+
+/// Largest payload of a valid record: a RESERVE with MAX_RESERVATION_SIZE coordinates.
+#define BIN_MAX_PAYLOAD (2 * 5 + 2 * 5 * MAX_RESERVATION_SIZE)
+
+/// Parser for binary job files.
+extern const struct CommandParser binary_parser;
+
+/// Detects the format of a job file from its first bytes.
+/// @param fd File descriptor to read from, positioned at the start of the file.
+/// @return Parser for the file, positioned at its first command. A binary file with an
+/// unsupported version gets a parser that reports no commands.
+const struct CommandParser *detect_parser(int fd);
+
+/// Writes the header of a binary job file.
+/// @param fd File descriptor to write to.
+/// @return 0 if the header was written successfully, 1 otherwise.
+int bin_write_header(int fd);
+
+/// Writes a CREATE command.
+/// @param fd File descriptor to write to.
+/// @param event_id Event ID.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_create(int fd, unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Writes a RESERVE command.
+/// @param fd File descriptor to write to.
+/// @param event_id Event ID.
+/// @param num_coords Number of coordinates.
+/// @param xs Array with the X coordinates.
+/// @param ys Array with the Y coordinates.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_reserve(int fd, unsigned int event_id, size_t num_coords, size_t *xs, size_t *ys);
+
+/// Writes a CANCEL command.
+/// @param fd File descriptor to write to.
+/// @param event_id Event ID.
+/// @param reservation_id Reservation ID.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_cancel(int fd, unsigned int event_id, unsigned int reservation_id);
+
+/// Writes a SHOW command.
+/// @param fd File descriptor to write to.
+/// @param event_id Event ID.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_show(int fd, unsigned int event_id);
+
+/// Writes a FORMAT command.
+/// @param fd File descriptor to write to.
+/// @param rle Whether SHOW uses the run-length encoded output.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_format(int fd, int rle);
+
+/// Writes a WAIT command.
+/// @param fd File descriptor to write to.
+/// @param delay Wait delay.
+/// @param thread_id Pointer to the thread ID, NULL if no thread was specified.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_wait(int fd, unsigned int delay, unsigned int *thread_id);
+
+/// Writes a command without arguments (LIST, BARRIER, HELP, BEGIN or COMMIT).
+/// @param fd File descriptor to write to.
+/// @param cmd Command to write.
+/// @return 0 if the command was written successfully, 1 otherwise.
+int bin_write_simple(int fd, enum Command cmd);
+
+#endif  // EMS_BINFORMAT_H
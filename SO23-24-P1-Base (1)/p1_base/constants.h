@@ -1,2 +1,5 @@
 #define MAX_RESERVATION_SIZE 256
 #define STATE_ACCESS_DELAY_MS 10
+#define MAX_JOB_FILES 4096
+#define MAX_OPEN_JOBS 256  // Cooperative jobs whose files are open at the same time.
+#define SHARED_STATE_SIZE (256UL << 20)  // Only the pages that are touched are backed by memory.
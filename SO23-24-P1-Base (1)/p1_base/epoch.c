@@ -0,0 +1,130 @@
+#include "epoch.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+struct EpochRecord {
+  atomic_int in_use;         /// Whether a reader holds the record.
+  atomic_ulong announced;    /// Epoch announced by the reader while reading, 0 otherwise.
+  struct EpochRecord* next;  /// Record of another reader.
+};
+
+struct EpochDomain {
+  atomic_ulong global_epoch;
+  struct EpochRecord* _Atomic records;  /// Records are only ever added, and reused by later readers.
+};
+
+struct EpochDomain* epoch_create() {
+  struct EpochDomain* domain = malloc(sizeof(struct EpochDomain));
+  if (!domain) return NULL;
+
+  atomic_init(&domain->global_epoch, 1);
+  atomic_init(&domain->records, NULL);
+  return domain;
+}
+
+void epoch_destroy(struct EpochDomain* domain) {
+  if (!domain) return;
+
+  struct EpochRecord* current = atomic_load(&domain->records);
+  while (current) {
+    struct EpochRecord* temp = current;
+    current = current->next;
+    free(temp);
+  }
+
+  free(domain);
+}
+
+/// Claims a record no other reader holds, adding one if they are all held.
+static struct EpochRecord* acquire_record(struct EpochDomain* domain) {
+  for (struct EpochRecord* current = atomic_load(&domain->records); current; current = current->next) {
+    int free_record = 0;
+    if (atomic_compare_exchange_strong(&current->in_use, &free_record, 1)) return current;
+  }
+
+  struct EpochRecord* new_record = malloc(sizeof(struct EpochRecord));
+  if (!new_record) return NULL;
+
+  atomic_init(&new_record->in_use, 1);
+  atomic_init(&new_record->announced, 0);
+  new_record->next = atomic_load(&domain->records);
+  while (!atomic_compare_exchange_weak(&domain->records, &new_record->next, new_record))
+    ;
+
+  return new_record;
+}
+
+/// Advances the global epoch if every reader has announced the current one.
+static void try_advance(struct EpochDomain* domain) {
+  unsigned long epoch = atomic_load(&domain->global_epoch);
+
+  for (struct EpochRecord* current = atomic_load(&domain->records); current; current = current->next) {
+    unsigned long announced = atomic_load(&current->announced);
+    if (announced != 0 && announced != epoch) return;
+  }
+
+  atomic_compare_exchange_strong(&domain->global_epoch, &epoch, epoch + 1);
+}
+
+struct EpochRecord* epoch_enter(struct EpochDomain* domain) {
+  struct EpochRecord* record = acquire_record(domain);
+  if (!record) return NULL;
+
+  atomic_store(&record->announced, atomic_load(&domain->global_epoch));
+  return record;
+}
+
+void epoch_exit(struct EpochRecord* record) {
+  atomic_store(&record->announced, 0);
+  atomic_store(&record->in_use, 0);
+}
+
+int epoch_retire(struct EpochDomain* domain, struct Retired** limbo, void* ptr) {
+  struct Retired* retired = malloc(sizeof(struct Retired));
+  if (!retired) return 1;
+
+  retired->ptr = ptr;
+  retired->epoch = atomic_load(&domain->global_epoch);
+  retired->next = *limbo;
+  *limbo = retired;
+
+  return 0;
+}
+
+void epoch_reclaim(struct EpochDomain* domain, struct Retired** limbo) {
+  try_advance(domain);
+
+  unsigned long epoch = atomic_load(&domain->global_epoch);
+
+  // The list is ordered from the newest to the oldest, so everything after the first reclaimable
+  // version is reclaimable too.
+  struct Retired** link = limbo;
+  while (*link && (*link)->epoch + 2 > epoch) {
+    link = &(*link)->next;
+  }
+
+  struct Retired* current = *link;
+  *link = NULL;
+
+  while (current) {
+    struct Retired* temp = current;
+    current = current->next;
+
+    free(temp->ptr);
+    free(temp);
+  }
+}
+
+void epoch_free_all(struct Retired** limbo) {
+  struct Retired* current = *limbo;
+  while (current) {
+    struct Retired* temp = current;
+    current = current->next;
+
+    free(temp->ptr);
+    free(temp);
+  }
+
+  *limbo = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef EMS_EPOCH_H
+#define EMS_EPOCH_H
+
+// Epoch-based reclamation: readers announce the global epoch of a domain while they hold pointers
+// to its shared versions, and a version retired in epoch e is only freed once the global epoch
+// reaches e + 2, which cannot happen while any reader still announces e. Domains share nothing, so
+// the readers and writers of one domain never touch the memory of another.
+
+struct EpochDomain;
+struct EpochRecord;
+
+struct Retired {
+  void* ptr;              /// Version to be freed.
+  unsigned long epoch;    /// Global epoch when the version was retired.
+  struct Retired* next;   /// Next retired version, retired in the same or an earlier epoch.
+};
+
+/// Creates an epoch domain.
+/// @return Pointer to the domain, NULL on failure.
+struct EpochDomain* epoch_create();
+
+/// Destroys an epoch domain and the records of its readers. Must only be called when there are no readers.
+/// @param domain Domain to be destroyed.
+void epoch_destroy(struct EpochDomain* domain);
+
+/// Marks the caller as reading the shared versions of a domain until epoch_exit.
+/// @param domain Domain whose versions are read.
+/// @return Record of the reader to pass to epoch_exit, NULL on failure.
+struct EpochRecord* epoch_enter(struct EpochDomain* domain);
+
+/// Marks the caller as no longer reading shared versions.
+/// @param record Record returned by epoch_enter.
+void epoch_exit(struct EpochRecord* record);
+
+/// Defers freeing a version that is no longer reachable until no reader can hold it.
+/// @param domain Domain the version belongs to.
+/// @param limbo List of retired versions, protected by the caller.
+/// @param ptr Version to be freed.
+/// @return 0 if the version was retired successfully, 1 otherwise.
+int epoch_retire(struct EpochDomain* domain, struct Retired** limbo, void* ptr);
+
+/// Frees the retired versions that no reader can hold anymore.
+/// @param domain Domain the versions belong to.
+/// @param limbo List of retired versions, protected by the caller.
+void epoch_reclaim(struct EpochDomain* domain, struct Retired** limbo);
+
+/// Frees every retired version. Must only be called when there are no readers.
+/// @param limbo List of retired versions.
+void epoch_free_all(struct Retired** limbo);
+
+#endif  // EMS_EPOCH_H
@@ -1,12 +1,21 @@
+#define _GNU_SOURCE  // MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE
 #include "eventlist.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Seat arrays of at least this many bytes are mapped instead of allocated on the heap.
+#define SEAT_MAPPING_MIN_SIZE (1UL << 17)
+#define HUGE_PAGE_SIZE (2UL << 20)
 
 struct EventList* create_list() {
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
   if (!list) return NULL;
   list->head = NULL;
   list->tail = NULL;
+  pthread_rwlock_init(&list->lock, NULL);
   return list;
 }
 
@@ -33,7 +42,15 @@ int append_to_list(struct EventList* list, struct Event* event) {
 static void free_event(struct Event* event) {
   if (!event) return;
 
-  free(event->data);
+  pthread_mutex_destroy(&event->mutex);
+
+  free_row_pages(event);
+  free(event->touched_pages);
+  epoch_free_all(&event->limbo);
+
+  free_seats(event->data, event->data_mapping);
+  free(event->index);
+  free(event->seat_arena);
   free(event);
 }
 
@@ -49,6 +66,7 @@ void free_list(struct EventList* list) {
     free(temp);
   }
 
+  pthread_rwlock_destroy(&list->lock);
   free(list);
 }
 
@@ -66,3 +84,175 @@ struct Event* get_event(struct EventList* list, unsigned int event_id) {
 
   return NULL;
 }
+
+unsigned int* alloc_seats(size_t num_seats, int hugepages, size_t* mapping) {
+  size_t size = num_seats * sizeof(unsigned int);
+  *mapping = 0;
+
+  if (size < SEAT_MAPPING_MIN_SIZE) return calloc(num_seats, sizeof(unsigned int));
+
+#ifdef MAP_HUGETLB
+  // Only succeeds if the system has reserved huge pages, and falls back to regular pages otherwise.
+  if (hugepages && size >= HUGE_PAGE_SIZE) {
+    size_t length = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    void* seats = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (seats != MAP_FAILED) {
+      *mapping = length;
+      return seats;
+    }
+  }
+#endif
+
+  size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t length = (size + page_size - 1) & ~(page_size - 1);
+  void* seats = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (seats == MAP_FAILED) return NULL;
+
+#ifdef MADV_HUGEPAGE
+  // Asks for transparent huge pages, which the kernel may or may not provide.
+  if (hugepages) madvise(seats, length, MADV_HUGEPAGE);
+#endif
+
+  *mapping = length;
+  return seats;
+}
+
+void free_seats(unsigned int* seats, size_t mapping) {
+  if (mapping == 0) {
+    free(seats);
+  } else if (seats) {
+    munmap(seats, mapping);
+  }
+}
+
+size_t num_row_pages(struct Event* event) { return (event->rows + ROW_PAGE_SIZE - 1) / ROW_PAGE_SIZE; }
+
+size_t page_rows(struct Event* event, size_t page) {
+  size_t first_row = page * ROW_PAGE_SIZE;
+  return event->rows - first_row < ROW_PAGE_SIZE ? event->rows - first_row : ROW_PAGE_SIZE;
+}
+
+int create_row_pages(struct Event* event) {
+  size_t num_pages = num_row_pages(event);
+  unsigned int*** pages = calloc(num_pages ? num_pages : 1, sizeof(unsigned int**));
+  if (!pages) return 1;
+
+  event->row_pages = pages;
+
+  for (size_t page = 0; page < num_pages; page++) {
+    pages[page] = malloc(ROW_PAGE_SIZE * sizeof(unsigned int*));
+    if (!pages[page]) {
+      free_row_pages(event);
+      return 1;
+    }
+
+    for (size_t i = 0; i < page_rows(event, page); i++) {
+      pages[page][i] = &event->data[(page * ROW_PAGE_SIZE + i) * event->cols];
+    }
+  }
+
+  return 0;
+}
+
+void free_row_pages(struct Event* event) {
+  unsigned int*** pages = event->row_pages;
+  if (!pages) return;
+
+  for (size_t page = 0; page < num_row_pages(event) && pages[page]; page++) {
+    for (size_t i = 0; i < page_rows(event, page); i++) {
+      if (!is_original_row(event, pages[page][i])) free(pages[page][i]);
+    }
+    free(pages[page]);
+  }
+
+  free(pages);
+  event->row_pages = NULL;
+}
+
+unsigned int* get_row(struct Event* event, unsigned int*** pages, size_t row) {
+  if (!pages) return &event->data[row * event->cols];
+
+  return pages[row / ROW_PAGE_SIZE][row % ROW_PAGE_SIZE];
+}
+
+int is_original_row(struct Event* event, unsigned int* row) {
+  return row >= event->data && row < event->data + event->rows * event->cols;
+}
+
+size_t* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats) {
+  if (!event || reservation_id == 0) return NULL;
+
+  if (reservation_id <= event->index_base) return NULL;
+
+  size_t num_entries = reservation_id - event->index_base;
+  if (num_entries > event->index_capacity) {
+    size_t capacity = event->index_capacity ? event->index_capacity * 2 : 16;
+    while (capacity < num_entries) capacity *= 2;
+
+    struct Reservation* index = realloc(event->index, capacity * sizeof(struct Reservation));
+    if (!index) return NULL;
+
+    event->index = index;
+    event->index_capacity = capacity;
+  }
+
+  if (event->arena_size + num_seats > event->arena_capacity) {
+    size_t capacity = event->arena_capacity ? event->arena_capacity * 2 : 64;
+    while (capacity < event->arena_size + num_seats) capacity *= 2;
+
+    size_t* arena = realloc(event->seat_arena, capacity * sizeof(size_t));
+    if (!arena) return NULL;
+
+    event->seat_arena = arena;
+    event->arena_capacity = capacity;
+  }
+
+  return &event->seat_arena[event->arena_size];
+}
+
+void commit_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats) {
+  struct Reservation* reservation = &event->index[reservation_id - event->index_base - 1];
+  reservation->offset = event->arena_size;
+  reservation->num_seats = num_seats;
+  event->arena_size += num_seats;
+  event->live_seats += num_seats;
+}
+
+struct Reservation* get_reservation(struct Event* event, unsigned int reservation_id) {
+  if (!event || reservation_id <= event->index_base || reservation_id > event->reservations) return NULL;
+
+  return &event->index[reservation_id - event->index_base - 1];
+}
+
+/// Compacts the index and the arena of an event, and gives back the memory no longer needed.
+static void compact_reservations(struct Event* event) {
+  size_t num_entries = event->reservations - event->index_base;
+  event->arena_size = pack_reservations(event->index, num_entries, event->seat_arena, event->index,
+                                        event->seat_arena, &num_entries);
+  event->index_base = event->reservations - (unsigned int)num_entries;
+
+  // If shrinking fails, the arrays just stay larger.
+  size_t index_capacity = shrunk_capacity(event->index_capacity, num_entries, 16);
+  struct Reservation* index = realloc(event->index, index_capacity * sizeof(struct Reservation));
+  if (index) {
+    event->index = index;
+    event->index_capacity = index_capacity;
+  }
+
+  size_t arena_capacity = shrunk_capacity(event->arena_capacity, event->arena_size, 64);
+  size_t* arena = realloc(event->seat_arena, arena_capacity * sizeof(size_t));
+  if (arena) {
+    event->seat_arena = arena;
+    event->arena_capacity = arena_capacity;
+  }
+}
+
+void cancel_reservation(struct Event* event, struct Reservation* reservation) {
+  event->live_seats -= reservation->num_seats;
+  reservation->num_seats = 0;
+
+  size_t num_entries = event->reservations - event->index_base;
+  if (should_compact_reservations(event->arena_size, event->live_seats, num_entries)) {
+    compact_reservations(event);
+  }
+}
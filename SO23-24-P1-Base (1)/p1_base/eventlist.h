@@ -1,8 +1,14 @@
 #ifndef EVENT_LIST_H
 #define EVENT_LIST_H
 
+#include <pthread.h>
 #include <stddef.h>
 
+#include "epoch.h"
+#include "reservation.h"
+
+#define ROW_PAGE_SIZE 64  // Number of rows in each page of the row table of an event.
+
 struct Event {
   unsigned int id;            /// Event id
   unsigned int reservations;  /// Number of reservations for the event.
@@ -11,17 +17,41 @@ struct Event {
   size_t rows;  /// Number of rows.
 
   unsigned int* data;  /// Array of size rows * cols with the reservations for each seat.
+  size_t data_mapping;  /// Length of the mapping holding data, 0 if data is on the heap.
+
+  /// With snapshot reads, the current version of each row, in pages of ROW_PAGE_SIZE rows. Rows start
+  /// out in data, and a write publishes copies of the rows it changes, of their pages and of the
+  /// directory of pages. NULL without snapshot reads, when the rows are only ever read from data.
+  unsigned int*** _Atomic row_pages;
+  unsigned int*** pending_pages;  /// Directory being written, not yet visible to readers. NULL until a row is copied.
+  size_t* touched_pages;          /// Pages copied by the pending write.
+  size_t num_touched;             /// Number of pages copied by the pending write.
+  size_t touched_capacity;        /// Number of entries allocated for touched_pages.
+  struct Retired* limbo;        /// Replaced row versions waiting to be freed.
+
+  pthread_mutex_t mutex;  /// Protects the seats and reservations of the event.
+
+  struct Reservation* index;  /// Array indexed by reservation id - index_base - 1 with the seats of each reservation.
+  size_t index_capacity;      /// Number of entries allocated for the index.
+  unsigned int index_base;    /// Number of leading reservations, all cancelled, dropped from the index.
+
+  size_t* seat_arena;     /// Seat indices of every reservation, stored contiguously.
+  size_t arena_size;      /// Number of seat indices in use in the arena.
+  size_t arena_capacity;  /// Number of seat indices allocated for the arena.
+  size_t live_seats;      /// Number of seat indices in the arena that belong to live reservations.
 };
 
+// Nodes are only ever appended and their links are atomic, so readers may walk the list without locks.
 struct ListNode {
   struct Event* event;
-  struct ListNode* next;
+  struct ListNode* _Atomic next;
 };
 
 // Linked list structure
 struct EventList {
-  struct ListNode* head;  // Head of the list
+  struct ListNode* _Atomic head;  // Head of the list
   struct ListNode* tail;  // Tail of the list
+  pthread_rwlock_t lock;  // Protects the nodes of the list
 };
 
 /// Creates a new event list.
@@ -45,4 +75,73 @@ void free_list(struct EventList* list);
 /// @return Pointer to the event if found, NULL otherwise.
 struct Event* get_event(struct EventList* list, unsigned int event_id);
 
+/// Allocates a zeroed seat array. Large arrays are mapped from demand-zero pages, so creating
+/// them takes no time and memory is only committed for the pages whose seats are touched.
+/// @param num_seats Number of seats of the array.
+/// @param hugepages Whether large arrays should be backed by huge pages where available.
+/// @param mapping Set to the length of the mapping holding the array, 0 if it is on the heap.
+/// @return Pointer to the seat array, NULL on failure.
+unsigned int* alloc_seats(size_t num_seats, int hugepages, size_t* mapping);
+
+/// Frees a seat array allocated by alloc_seats.
+/// @param seats Seat array to be freed.
+/// @param mapping Length of the mapping returned by alloc_seats.
+void free_seats(unsigned int* seats, size_t mapping);
+
+/// Creates the row table of an event, with every row pointing to the data of the event.
+/// @param event Event whose rows are published as versions.
+/// @return 0 if the row table was created successfully, 1 otherwise.
+int create_row_pages(struct Event* event);
+
+/// Frees the row table of an event and the row versions it holds.
+/// @param event Event with no readers and no pending write.
+void free_row_pages(struct Event* event);
+
+/// Returns the number of pages in the row table of an event.
+size_t num_row_pages(struct Event* event);
+
+/// Returns the number of rows in a page of the row table of an event.
+size_t page_rows(struct Event* event, size_t page);
+
+/// Retrieves a row of an event.
+/// @param event Event the row belongs to.
+/// @param pages Version of the row table to read the row from, NULL to read it from the data of the event.
+/// @param row Index of the row.
+/// @return Pointer to the first seat of the row.
+unsigned int* get_row(struct Event* event, unsigned int*** pages, size_t row);
+
+/// Checks whether a row version is the original one, stored in the data of the event.
+/// @param event Event the row belongs to.
+/// @param row Row version.
+/// @return 1 if the row is stored in the data of the event, 0 if it is a copy.
+int is_original_row(struct Event* event, unsigned int* row);
+
+/// Makes room in the reservation index and seat arena of an event for a new reservation.
+/// @param event Event to be modified.
+/// @param reservation_id Id of the new reservation.
+/// @param num_seats Number of seats of the new reservation.
+/// @return Pointer to the arena slots where the seat indices must be written, NULL on failure.
+size_t* prepare_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats);
+
+/// Records a reservation whose seat indices were written to the slots returned by prepare_reservation.
+/// @param event Event to be modified.
+/// @param reservation_id Id of the reservation.
+/// @param num_seats Number of seats of the reservation.
+void commit_reservation(struct Event* event, unsigned int reservation_id, size_t num_seats);
+
+/// Retrieves a reservation of an event.
+/// @param event Event to be searched.
+/// @param reservation_id Reservation id.
+/// @return Pointer to the reservation if found, NULL otherwise. Cancelled reservations may be
+/// found with no seats, or not found at all.
+struct Reservation* get_reservation(struct Event* event, unsigned int reservation_id);
+
+/// Records that a reservation was cancelled. Once the seats of cancelled reservations outnumber the
+/// live ones, the arena is compacted and the leading cancelled entries are dropped from the index,
+/// so memory follows the live reservations rather than every reservation ever made. Pointers to
+/// reservations and arena slots are invalidated.
+/// @param event Event the reservation belongs to.
+/// @param reservation Reservation whose seats were freed.
+void cancel_reservation(struct Event* event, struct Reservation* reservation);
+
 #endif  // EVENT_LIST_H
@@ -0,0 +1,189 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binformat.h"
+#include "constants.h"
+#include "parser.h"
+
+// Converts text job files (.jobs) to binary job files (.jobsb) and back. The direction is picked
+// from the format of the input file. Comments and empty lines are not preserved.
+
+static int write_text(int fd, enum Command cmd, unsigned int event_id, unsigned int arg, size_t num_rows,
+                      size_t num_cols, size_t num_coords, size_t *xs, size_t *ys, unsigned int *thread_id) {
+  switch (cmd) {
+    case CMD_CREATE:
+      return dprintf(fd, "CREATE %u %zu %zu\n", event_id, num_rows, num_cols) < 0;
+
+    case CMD_RESERVE:
+      if (dprintf(fd, "RESERVE %u [", event_id) < 0) {
+        return 1;
+      }
+      for (size_t i = 0; i < num_coords; i++) {
+        if (dprintf(fd, "%s(%zu,%zu)", i > 0 ? " " : "", xs[i], ys[i]) < 0) {
+          return 1;
+        }
+      }
+      return dprintf(fd, "]\n") < 0;
+
+    case CMD_CANCEL:
+      return dprintf(fd, "CANCEL %u %u\n", event_id, arg) < 0;
+
+    case CMD_SHOW:
+      return dprintf(fd, "SHOW %u\n", event_id) < 0;
+
+    case CMD_FORMAT:
+      return dprintf(fd, "FORMAT %s\n", arg ? "RLE" : "PLAIN") < 0;
+
+    case CMD_WAIT:
+      if (thread_id != NULL) {
+        return dprintf(fd, "WAIT %u %u\n", arg, *thread_id) < 0;
+      }
+      return dprintf(fd, "WAIT %u\n", arg) < 0;
+
+    case CMD_LIST_EVENTS:
+      return dprintf(fd, "LIST\n") < 0;
+
+    case CMD_BARRIER:
+      return dprintf(fd, "BARRIER\n") < 0;
+
+    case CMD_HELP:
+      return dprintf(fd, "HELP\n") < 0;
+
+    case CMD_BEGIN:
+      return dprintf(fd, "BEGIN\n") < 0;
+
+    case CMD_COMMIT:
+      return dprintf(fd, "COMMIT\n") < 0;
+
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+    default:
+      return 1;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <input_file> <output_file>\n", argv[0]);
+    return 1;
+  }
+
+  int in_fd = open(argv[1], O_RDONLY);
+  if (in_fd < 0) {
+    perror("Failed to open input file");
+    return 1;
+  }
+
+  int out_fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (out_fd < 0) {
+    perror("Failed to open output file");
+    close(in_fd);
+    return 1;
+  }
+
+  const struct CommandParser *parser = detect_parser(in_fd);
+  int to_binary = parser == &text_parser;
+
+  if (to_binary && bin_write_header(out_fd) != 0) {
+    fprintf(stderr, "Failed to write output file\n");
+    close(in_fd);
+    close(out_fd);
+    return 1;
+  }
+
+  int ret = 0;
+  size_t line = 0;
+  enum Command cmd;
+
+  while ((cmd = parser->get_next(in_fd)) != EOC) {
+    unsigned int event_id = 0, arg = 0, thread_id = 0;
+    size_t num_rows = 0, num_cols = 0, num_coords = 0;
+    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    int has_thread = 0, invalid = 0, rle = 0;
+
+    line++;
+
+    switch (cmd) {
+      case CMD_CREATE:
+        invalid = parser->parse_create(in_fd, &event_id, &num_rows, &num_cols) != 0;
+        break;
+
+      case CMD_RESERVE:
+        num_coords = parser->parse_reserve(in_fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
+        invalid = num_coords == 0;
+        break;
+
+      case CMD_CANCEL:
+        invalid = parser->parse_cancel(in_fd, &event_id, &arg) != 0;
+        break;
+
+      case CMD_SHOW:
+        invalid = parser->parse_show(in_fd, &event_id) != 0;
+        break;
+
+      case CMD_FORMAT:
+        invalid = parser->parse_format(in_fd, &rle) != 0;
+        arg = (unsigned int)rle;
+        break;
+
+      case CMD_WAIT:
+        has_thread = parser->parse_wait(in_fd, &arg, &thread_id);
+        invalid = has_thread == -1;
+        break;
+
+      case CMD_EMPTY:
+        continue;
+
+      case CMD_INVALID:
+        invalid = 1;
+        break;
+
+      case CMD_LIST_EVENTS:
+      case CMD_BARRIER:
+      case CMD_HELP:
+      case CMD_BEGIN:
+      case CMD_COMMIT:
+      case EOC:
+      default:
+        break;
+    }
+
+    if (invalid) {
+      fprintf(stderr, "Skipping invalid command %zu\n", line);
+      continue;
+    }
+
+    int failed;
+    if (!to_binary) {
+      failed = write_text(out_fd, cmd, event_id, arg, num_rows, num_cols, num_coords, xs, ys,
+                          has_thread ? &thread_id : NULL);
+    } else if (cmd == CMD_CREATE) {
+      failed = bin_write_create(out_fd, event_id, num_rows, num_cols);
+    } else if (cmd == CMD_RESERVE) {
+      failed = bin_write_reserve(out_fd, event_id, num_coords, xs, ys);
+    } else if (cmd == CMD_CANCEL) {
+      failed = bin_write_cancel(out_fd, event_id, arg);
+    } else if (cmd == CMD_SHOW) {
+      failed = bin_write_show(out_fd, event_id);
+    } else if (cmd == CMD_FORMAT) {
+      failed = bin_write_format(out_fd, rle);
+    } else if (cmd == CMD_WAIT) {
+      failed = bin_write_wait(out_fd, arg, has_thread ? &thread_id : NULL);
+    } else {
+      failed = bin_write_simple(out_fd, cmd);
+    }
+
+    if (failed) {
+      fprintf(stderr, "Failed to write output file\n");
+      ret = 1;
+      break;
+    }
+  }
+
+  close(in_fd);
+  close(out_fd);
+  return ret;
+}
@@ -1,17 +1,485 @@
+#include <dirent.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
+#include "binformat.h"
 #include "constants.h"
 #include "operations.h"
 #include "parser.h"
+#include "scheduler.h"
+#include "shard.h"
+#include "shmstate.h"
+
+/// Commands over one of the EMS states.
+struct Backend {
+  int (*create)(unsigned int event_id, size_t num_rows, size_t num_cols);
+  int (*reserve)(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+  int (*reserve_batch)(struct ReservationRequest *requests, size_t num_requests);
+  int (*cancel)(unsigned int event_id, unsigned int reservation_id);
+  int (*show)(unsigned int event_id, int out_fd, int rle);
+  int (*list_events)(int out_fd);
+};
+
+/// EMS instance of the local state.
+static struct ems_instance *ems = NULL;
+
+static int local_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  return ems_create(ems, event_id, num_rows, num_cols);
+}
+
+static int local_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+  return ems_reserve(ems, event_id, num_seats, xs, ys);
+}
+
+static int local_reserve_batch(struct ReservationRequest *requests, size_t num_requests) {
+  return ems_reserve_batch(ems, requests, num_requests);
+}
+
+static int local_cancel(unsigned int event_id, unsigned int reservation_id) {
+  return ems_cancel(ems, event_id, reservation_id);
+}
+
+static int local_show(unsigned int event_id, int out_fd, int rle) {
+  struct ems_output out = {ems_write_fd, &out_fd, rle};
+  return ems_show(ems, event_id, &out);
+}
+
+static int local_list_events(int out_fd) {
+  struct ems_output out = {ems_write_fd, &out_fd, 0};
+  return ems_list_events(ems, &out);
+}
+
+static int reserve_each(struct ReservationRequest *requests, size_t num_requests);
+
+static const struct Backend local_backend = {local_create, local_reserve, local_reserve_batch, local_cancel, local_show,
+                                             local_list_events};
+static const struct Backend sharded_backend = {shard_create, shard_reserve, reserve_each, shard_cancel, shard_show,
+                                               shard_list_events};
+static const struct Backend shared_backend = {shared_create, shared_reserve, reserve_each, shared_cancel, shared_show,
+                                              shared_list_events};
+
+/// EMS state the commands are run against.
+static const struct Backend *backend = &local_backend;
+
+/// Creates the reservations of a batch one at a time, for the states without batched reservations.
+static int reserve_each(struct ReservationRequest *requests, size_t num_requests) {
+  int ret = 0;
+
+  for (size_t r = 0; r < num_requests; r++) {
+    requests[r].result = backend->reserve(requests[r].event_id, requests[r].num_seats, requests[r].xs, requests[r].ys);
+    ret |= requests[r].result;
+  }
+
+  return ret;
+}
+
+struct Job {
+  char *path;                          /// Path of the job file.
+  char *out_path;                      /// Path of the file the output of the job is written to.
+  int fd;                              /// Job file being executed, -1 while the job is not running.
+  int out_fd;                          /// File the output of the job is written to, -1 while the job is not running.
+  const struct CommandParser *parser;  /// Parser for the format of the job file.
+  int rle;                             /// Whether SHOW prints events run-length encoded.
+
+  int in_batch;                        /// Whether RESERVEs are batched until the next COMMIT.
+  struct ReservationRequest *batch;    /// RESERVEs batched since the batch was last applied.
+  size_t batch_size;
+  size_t batch_capacity;
+};
+
+static int add_to_batch(struct Job *job, unsigned int event_id, size_t num_coords, size_t *xs, size_t *ys) {
+  if (job->batch_size == job->batch_capacity) {
+    size_t capacity = job->batch_capacity ? job->batch_capacity * 2 : 64;
+    struct ReservationRequest *batch = realloc(job->batch, capacity * sizeof(struct ReservationRequest));
+
+    if (batch == NULL) {
+      fprintf(stderr, "Error allocating memory for batch\n");
+      return 1;
+    }
+
+    job->batch = batch;
+    job->batch_capacity = capacity;
+  }
+
+  size_t *coords = malloc(2 * num_coords * sizeof(size_t));
+  if (coords == NULL) {
+    fprintf(stderr, "Error allocating memory for batch\n");
+    return 1;
+  }
+
+  memcpy(coords, xs, num_coords * sizeof(size_t));
+  memcpy(coords + num_coords, ys, num_coords * sizeof(size_t));
+
+  job->batch[job->batch_size++] = (struct ReservationRequest){event_id, num_coords, coords, coords + num_coords, 0};
+  return 0;
+}
+
+static void apply_batch(struct Job *job) {
+  backend->reserve_batch(job->batch, job->batch_size);
+
+  for (size_t r = 0; r < job->batch_size; r++) {
+    if (job->batch[r].result) {
+      fprintf(stderr, "Failed to reserve seats\n");
+    }
+
+    free(job->batch[r].xs);  // Holds the ys too.
+  }
+
+  job->batch_size = 0;
+}
+
+/// Reads and executes the next command of a job.
+/// @param job Job to execute.
+/// @return Milliseconds the job must wait before its next command, TASK_DONE once the job file ends.
+static long execute_next(struct Job *job) {
+  unsigned int event_id, reservation_id, delay;
+  int rle;
+  size_t num_rows, num_columns, num_coords;
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+
+  printf("> ");
+  fflush(stdout);
+
+  enum Command cmd = job->parser->get_next(job->fd);
+
+  // Only RESERVEs are batched, so any other command first applies the RESERVEs batched before it.
+  if (job->batch_size > 0 && cmd != CMD_RESERVE && cmd != CMD_EMPTY) {
+    apply_batch(job);
+  }
+
+  switch (cmd) {
+    case CMD_CREATE:
+      if (job->parser->parse_create(job->fd, &event_id, &num_rows, &num_columns) != 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      if (backend->create(event_id, num_rows, num_columns)) {
+        fprintf(stderr, "Failed to create event\n");
+      }
+
+      break;
+
+    case CMD_RESERVE:
+      num_coords = job->parser->parse_reserve(job->fd, MAX_RESERVATION_SIZE, &event_id, xs, ys);
+
+      if (num_coords == 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      if (job->in_batch) {
+        if (add_to_batch(job, event_id, num_coords, xs, ys) != 0) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+      } else if (backend->reserve(event_id, num_coords, xs, ys)) {
+        fprintf(stderr, "Failed to reserve seats\n");
+      }
+
+      break;
+
+    case CMD_CANCEL:
+      if (job->parser->parse_cancel(job->fd, &event_id, &reservation_id) != 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      if (backend->cancel(event_id, reservation_id)) {
+        fprintf(stderr, "Failed to cancel reservation\n");
+      }
+
+      break;
+
+    case CMD_SHOW:
+      if (job->parser->parse_show(job->fd, &event_id) != 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      if (backend->show(event_id, job->out_fd, job->rle)) {
+        fprintf(stderr, "Failed to show event\n");
+      }
+
+      break;
+
+    case CMD_FORMAT:
+      if (job->parser->parse_format(job->fd, &rle) != 0) {
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      job->rle = rle;
+      break;
+
+    case CMD_LIST_EVENTS:
+      if (backend->list_events(job->out_fd)) {
+        fprintf(stderr, "Failed to list events\n");
+      }
+
+      break;
+
+    case CMD_WAIT:
+      if (job->parser->parse_wait(job->fd, &delay, NULL) == -1) {  // thread_id is not implemented
+        fprintf(stderr, "Invalid command. See HELP for usage\n");
+        return 0;
+      }
+
+      if (delay > 0) {
+        printf("Waiting...\n");
+        return (long)delay;
+      }
+
+      break;
+
+    case CMD_BEGIN:
+      if (job->in_batch) {
+        fprintf(stderr, "Batch already started\n");
+      }
+
+      job->in_batch = 1;
+      break;
+
+    case CMD_COMMIT:
+      if (!job->in_batch) {
+        fprintf(stderr, "No batch to commit\n");
+      }
+
+      job->in_batch = 0;
+      break;
+
+    case CMD_INVALID:
+      fprintf(stderr, "Invalid command. See HELP for usage\n");
+      break;
+
+    case CMD_HELP:
+      printf(
+          "Available commands:\n"
+          "  CREATE <event_id> <num_rows> <num_columns>\n"
+          "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+          "  CANCEL <event_id> <reservation_id>\n"
+          "  SHOW <event_id>\n"
+          "  FORMAT <PLAIN | RLE>\n"
+          "  LIST\n"
+          "  WAIT <delay_ms> [thread_id]\n"  // thread_id is not implemented
+          "  BARRIER\n"                      // Not implemented
+          "  BEGIN\n"
+          "  COMMIT\n"
+          "  HELP\n");
+
+      break;
+
+    case CMD_BARRIER:  // Not implemented
+    case CMD_EMPTY:
+      break;
+
+    case EOC:
+      return TASK_DONE;
+  }
+
+  return 0;
+}
+
+/// Set once a job could not be run because its files could not be opened.
+static atomic_int job_open_failed = 0;
+
+/// Opens the files of a job when it starts, so that only the running jobs hold file descriptors.
+/// @return 0 if the job was opened successfully, 1 if it must be skipped.
+static int open_job(struct Job *job, int rle) {
+  job->fd = open(job->path, O_RDONLY);
+  if (job->fd == -1) {
+    fprintf(stderr, "Failed to open job file %s\n", job->path);
+    atomic_store(&job_open_failed, 1);
+    return 1;
+  }
+
+  job->out_fd = open(job->out_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+  if (job->out_fd == -1) {
+    fprintf(stderr, "Failed to open output file %s\n", job->out_path);
+    atomic_store(&job_open_failed, 1);
+    close(job->fd);
+    job->fd = -1;
+    return 1;
+  }
+
+  job->parser = detect_parser(job->fd);
+  job->rle = rle;
+  return 0;
+}
+
+static void close_job(struct Job *job) {
+  close(job->fd);
+  close(job->out_fd);
+  job->fd = -1;
+  job->out_fd = -1;
+}
+
+/// Jobs taken in order by the cooperative tasks, each task running one job at a time.
+static struct Job *job_queue = NULL;
+static int job_queue_size = 0;
+static int job_queue_rle = 0;
+static atomic_int job_queue_next = 0;
+
+/// Takes the next job of the queue and opens it, skipping the jobs that cannot be opened.
+/// @return Job to run, NULL once every job has been taken.
+static struct Job *take_job(void) {
+  int i;
+  while ((i = atomic_fetch_add(&job_queue_next, 1)) < job_queue_size) {
+    if (open_job(&job_queue[i], job_queue_rle) == 0) {
+      return &job_queue[i];
+    }
+  }
+
+  return NULL;
+}
+
+/// Runs one command of a job as a cooperative task, and moves on to the next job of the queue once
+/// the job ends. The simulated state access delays of the command suspend the task instead of its worker.
+/// @param arg Slot with the job the task is running, NULL until it takes its first job.
+static long run_job_step(void *arg) {
+  struct Job **job = arg;
+
+  if (*job == NULL && (*job = take_job()) == NULL) {
+    return TASK_DONE;
+  }
+
+  ems_defer_delays(1);
+
+  long delay = execute_next(*job);
+  unsigned long access_delay = ems_take_deferred_delay();
+
+  if (delay == TASK_DONE) {
+    close_job(*job);
+    *job = NULL;
+    delay = 0;
+  }
+
+  return delay + (long)access_delay;
+}
+
+static void run_sequential(struct Job *jobs, int num_jobs, int rle) {
+  for (int i = 0; i < num_jobs; i++) {
+    if (open_job(&jobs[i], rle) != 0) {
+      continue;
+    }
+
+    long delay;
+    while ((delay = execute_next(&jobs[i])) != TASK_DONE) {
+      if (delay > 0) {
+        ems_wait((unsigned int)delay);
+      }
+    }
+
+    close_job(&jobs[i]);
+  }
+}
+
+/// Runs the jobs as tasks on the workers. At most MAX_OPEN_JOBS tasks are spawned, each running jobs
+/// one after another, so that thousands of job files do not hold their file descriptors all at once.
+static int run_cooperative(struct Job *jobs, int num_jobs, unsigned int num_workers, int rle) {
+  if (scheduler_init(num_workers) != 0) {
+    return 1;
+  }
+
+  int num_tasks = num_jobs < MAX_OPEN_JOBS ? num_jobs : MAX_OPEN_JOBS;
+  struct Job **running = calloc((size_t)(num_tasks ? num_tasks : 1), sizeof(struct Job *));
+  if (running == NULL) {
+    fprintf(stderr, "Error allocating memory for tasks\n");
+    return 1;
+  }
+
+  job_queue = jobs;
+  job_queue_size = num_jobs;
+  job_queue_rle = rle;
+  atomic_store(&job_queue_next, 0);
+
+  for (int i = 0; i < num_tasks; i++) {
+    if (scheduler_spawn(run_job_step, &running[i]) != 0) {
+      free(running);
+      return 1;
+    }
+  }
+
+  int ret = scheduler_run();
+  free(running);
+  return ret;
+}
+
+/// Runs the jobs on forked worker processes that serve the shared EMS state, job i on process
+/// i % num_procs.
+/// @return 0 if every worker process exited normally, 1 otherwise.
+static int run_processes(struct Job *jobs, int num_jobs, int num_procs, int rle) {
+  pid_t *children = malloc((size_t)num_procs * sizeof(pid_t));
+  if (children == NULL) {
+    fprintf(stderr, "Error allocating memory for worker processes\n");
+    return 1;
+  }
+
+  // Otherwise the children would print the output buffered so far again.
+  fflush(stdout);
+
+  int started = 0;
+  for (; started < num_procs && started < num_jobs; started++) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+      fprintf(stderr, "Failed to create worker process\n");
+      break;
+    }
+
+    if (pid == 0) {
+      for (int i = started; i < num_jobs; i += num_procs) {
+        run_sequential(&jobs[i], 1, rle);
+      }
+
+      fflush(stdout);
+      _exit(atomic_load(&job_open_failed));
+    }
+
+    children[started] = pid;
+  }
+
+  // The jobs of the processes that could not be created run on this one.
+  for (int proc = started; proc < num_procs; proc++) {
+    for (int i = proc; i < num_jobs; i += num_procs) {
+      run_sequential(&jobs[i], 1, rle);
+    }
+  }
+
+  int ret = 0;
+  for (int i = 0; i < started; i++) {
+    int status;
+    if (waitpid(children[i], &status, 0) == -1) {
+      fprintf(stderr, "Failed to wait for worker process\n");
+      ret = 1;
+    } else if (WIFSIGNALED(status)) {
+      fprintf(stderr, "Worker process %ld was terminated by signal %d\n", (long)children[i], WTERMSIG(status));
+      ret = 1;
+    } else if (WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Worker process %ld exited with status %d\n", (long)children[i], WEXITSTATUS(status));
+      ret = 1;
+    }
+  }
+
+  free(children);
+  return ret;
+}
+
+static int MAX_PROC;
+static int MAX_THREADS;
 
 int main(int argc, char *argv[]) {
   unsigned int state_access_delay_ms = STATE_ACCESS_DELAY_MS;
 
-  if (argc < 4) {
-        fprintf(stderr, "Usage: %s <state_access_delay_ms> <jobs_directory> <max_proc>, <max_threads>\n", argv[0]);
+  if (argc < 5) {
+        fprintf(stderr, "Usage: %s <state_access_delay_ms> <jobs_directory> <max_proc>, <max_threads> [--cooperative | --sharded | --processes] [--snapshot-reads] [--rle-show] [--hugepages]\n", argv[0]);
         return 1;
     }
 
@@ -36,175 +504,180 @@ int main(int argc, char *argv[]) {
     }
 
 
-    if (ems_init(state_access_delay_ms)) {
-        fprintf(stderr, "Failed to initialize EMS\n");
+    // --cooperative runs the job files as tasks on MAX_THREADS workers instead of one after another.
+    // --sharded partitions the events across MAX_THREADS shard threads that own them.
+    // --processes runs the job files on MAX_PROC forked processes that share the EMS state in shared memory.
+    // --snapshot-reads lets SHOW and LIST read consistent snapshots without blocking writers.
+    // --rle-show makes SHOW print events run-length encoded, until a job file changes it with FORMAT.
+    // --hugepages backs the seats of large events with huge pages.
+    int cooperative = 0, sharded = 0, processes = 0, snapshot_reads = 0, rle_show = 0, hugepages = 0;
+    for (int i = 5; i < argc; i++) {
+        if (strcmp(argv[i], "--cooperative") == 0) {
+            cooperative = 1;
+        } else if (strcmp(argv[i], "--sharded") == 0) {
+            sharded = 1;
+        } else if (strcmp(argv[i], "--processes") == 0) {
+            processes = 1;
+        } else if (strcmp(argv[i], "--snapshot-reads") == 0) {
+            snapshot_reads = 1;
+        } else if (strcmp(argv[i], "--rle-show") == 0) {
+            rle_show = 1;
+        } else if (strcmp(argv[i], "--hugepages") == 0) {
+            hugepages = 1;
+        } else {
+            fprintf(stderr, "Invalid option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (cooperative + sharded + processes > 1) {
+        fprintf(stderr, "--cooperative, --sharded and --processes cannot be combined\n");
         return 1;
     }
-  DIR *dirp;
-    struct dirent *dp;
-    dirp = opendir(argv[2]);
 
-    char *files[100];
-    char *files_output[100];
-    int amount_of_files = 0;
+    if (processes && snapshot_reads) {
+        fprintf(stderr, "--snapshot-reads is not supported with --processes\n");
+        return 1;
+    }
 
-    if (dirp == NULL) {
-        perror("opendir failed");
-        return;
+    if (processes && hugepages) {
+        fprintf(stderr, "--hugepages is not supported with --processes\n");
+        return 1;
     }
 
-    for (;;) {
-        errno = 0; 
-        dp = readdir(dirp);
-        if (dp == NULL)
-            break;
-        if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0)
-            continue; /* Skip . and .. */
-        
-
-        char *file = malloc(128);
-      // Find the position of the last dot (.) in the input file name
-    const char *dotPosition = strrchr(file, '.');
-
-    // Check if a dot was found and it is not the first character in the file name
-    if (dotPosition != NULL && dotPosition != file) {
-        // Calculate the length of the file name excluding the extension
-        size_t fileNameLength = (size_t)(dotPosition - file);
-
-        // Allocate memory for the output file name
-        char *outputFileName = (char *)malloc(fileNameLength + 5); // 5 for ".out\0"
-
-        if (outputFileName != NULL) {
-            // Copy the file name to the output file name
-            strncpy(outputFileName, file, fileNameLength);
-
-            // Add the ".out" extension
-            strcpy(outputFileName + fileNameLength, ".out");
-
-            // Create and open the output file
-            int outputFile =open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-
-            if (outputFile != NULL) {
-                // Close the output file
-                close(outputFile, NULL);
-            } else {
-                printf("Error creating output file '%s'.\n", outputFileName);
-            }
-        } else {
-            printf("Memory allocation error.\n");
+    // SHOW formats large events on MAX_THREADS threads, the one running the command included. The
+    // worker processes format their events themselves, so they have no use for the pool.
+    struct ThreadPool *pool = NULL;
+    if (!processes) {
+        pool = ems_pool_create((unsigned int)MAX_THREADS - 1);
+        if (pool == NULL) {
+            fprintf(stderr, "Failed to start thread pool\n");
+            return 1;
         }
-    } else {
-        printf("Invalid file name format. Unable to determine extension.\n");
     }
-        files[amount_of_files] = strdup(file);
-        files_output[amount_of_files] = strdup(outputFile);
-        // Free the allocated memory for the output file name
-        free(outputFileName);
-        amount_of_files++;
+
+    struct ems_options options = {state_access_delay_ms, snapshot_reads, hugepages, pool};
+
+    ems = ems_init(&options);
+    if (ems == NULL) {
+        fprintf(stderr, "Failed to initialize EMS\n");
+        return 1;
     }
-    
-    closedir(dirp);
-    int file_num = 0;
-    set_output_file(files_output[file_num]);
-
-  while (1) {
-    unsigned int event_id, delay;
-    size_t num_rows, num_columns, num_coords;
-    size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
-
-    printf("> ");
-    fflush(stdout);
-
-    switch (get_next(file[file_num])) {
-      case CMD_CREATE:
-        if (parse_create(file[file_num], &event_id, &num_rows, &num_columns) != 0) {
-          fprintf(stderr, "Invalid command. See HELP for usage\n");
-          continue;
+
+    if (sharded) {
+        if (shards_init((unsigned int)MAX_THREADS, &options)) {
+            fprintf(stderr, "Failed to start shards\n");
+            return 1;
         }
+        backend = &sharded_backend;
+    }
 
-        if (ems_create(event_id, num_rows, num_columns)) {
-          fprintf(stderr, "Failed to create event\n");
+    if (processes) {
+        if (shared_init(state_access_delay_ms, SHARED_STATE_SIZE)) {
+            fprintf(stderr, "Failed to create shared EMS state\n");
+            return 1;
         }
+        backend = &shared_backend;
+    }
 
-        break;
+    DIR *dirp = opendir(argv[2]);
+    if (dirp == NULL) {
+        perror("opendir failed");
+        ems_terminate(ems);
+        return 1;
+    }
 
-      case CMD_RESERVE:
-        num_coords = parse_reserve(file[file_num], MAX_RESERVATION_SIZE, &event_id, xs, ys);
+    char *files[MAX_JOB_FILES];
+    char *files_output[MAX_JOB_FILES];
+    int amount_of_files = 0;
 
-        if (num_coords == 0) {
-          fprintf(stderr, "Invalid command. See HELP for usage\n");
-          continue;
+    struct dirent *dp;
+    while ((dp = readdir(dirp)) != NULL) {
+        // Only .jobs and .jobsb files are run, and each one writes to the .out file with the same name.
+        const char *dotPosition = strrchr(dp->d_name, '.');
+        if (dotPosition == NULL || dotPosition == dp->d_name ||
+            (strcmp(dotPosition, ".jobs") != 0 && strcmp(dotPosition, ".jobsb") != 0))
+            continue;
+
+        if (amount_of_files == MAX_JOB_FILES) {
+            fprintf(stderr, "Too many job files, only the first %d are run\n", MAX_JOB_FILES);
+            break;
         }
 
-        if (ems_reserve(event_id, num_coords, xs, ys)) {
-          fprintf(stderr, "Failed to reserve seats\n");
+        size_t dirLength = strlen(argv[2]);
+        size_t fileNameLength = (size_t)(dotPosition - dp->d_name);
+        char *file = malloc(dirLength + strlen(dp->d_name) + 2);
+        char *outputFile = malloc(dirLength + fileNameLength + 6);  // 6 for "/" and ".out\0"
+        if (file == NULL || outputFile == NULL) {
+            fprintf(stderr, "Memory allocation error.\n");
+            free(file);
+            free(outputFile);
+            break;
         }
 
-        break;
+        sprintf(file, "%s/%s", argv[2], dp->d_name);
+        sprintf(outputFile, "%s/%.*s.out", argv[2], (int)fileNameLength, dp->d_name);
+        files[amount_of_files] = file;
+        files_output[amount_of_files] = outputFile;
+        amount_of_files++;
+    }
 
-      case CMD_SHOW:
-        if (parse_show(file[file_num], &event_id) != 0) {
-          fprintf(stderr, "Invalid command. See HELP for usage\n");
-          continue;
-        }
+    closedir(dirp);
 
-        if (ems_show(event_id)) {
-          fprintf(stderr, "Failed to show event\n");
-        }
+    struct Job *jobs = malloc((size_t)(amount_of_files ? amount_of_files : 1) * sizeof(struct Job));
+    if (jobs == NULL) {
+        fprintf(stderr, "Error allocating memory for jobs\n");
+        ems_terminate(ems);
+        return 1;
+    }
 
-        break;
+    // The files of a job are only opened once it starts.
+    for (int i = 0; i < amount_of_files; i++) {
+        jobs[i].path = files[i];
+        jobs[i].out_path = files_output[i];
+        jobs[i].fd = -1;
+        jobs[i].out_fd = -1;
+        jobs[i].in_batch = 0;
+        jobs[i].batch = NULL;
+        jobs[i].batch_size = 0;
+        jobs[i].batch_capacity = 0;
+    }
 
-      case CMD_LIST_EVENTS:
-        if (ems_list_events()) {
-          fprintf(stderr, "Failed to list events\n");
+    int ret = 0;
+    if (cooperative) {
+        if (run_cooperative(jobs, amount_of_files, (unsigned int)MAX_THREADS, rle_show) != 0) {
+            fprintf(stderr, "Failed to run jobs cooperatively\n");
+            ret = 1;
         }
-
-        break;
-
-      case CMD_WAIT:
-        if (parse_wait(file[file_num], &delay, NULL) == -1) {  // thread_id is not implemented
-          fprintf(stderr, "Invalid command. See HELP for usage\n");
-          continue;
+    } else if (processes) {
+        if (run_processes(jobs, amount_of_files, MAX_PROC, rle_show) != 0) {
+            fprintf(stderr, "Failed to run jobs on worker processes\n");
+            ret = 1;
         }
+    } else {
+        run_sequential(jobs, amount_of_files, rle_show);
+    }
 
-        if (delay > 0) {
-          printf("Waiting...\n");
-          ems_wait(delay);
-        }
+    if (atomic_load(&job_open_failed)) {
+        ret = 1;
+    }
 
-        break;
+    for (int i = 0; i < amount_of_files; i++) {
+        free(jobs[i].path);
+        free(jobs[i].out_path);
+        free(jobs[i].batch);
+    }
+    free(jobs);
 
-      case CMD_INVALID:
-        fprintf(stderr, "Invalid command. See HELP for usage\n");
-        break;
-
-      case CMD_HELP:
-        printf(
-            "Available commands:\n"
-            "  CREATE <event_id> <num_rows> <num_columns>\n"
-            "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
-            "  SHOW <event_id>\n"
-            "  LIST\n"
-            "  WAIT <delay_ms> [thread_id]\n"  // thread_id is not implemented
-            "  BARRIER\n"                      // Not implemented
-            "  HELP\n");
-
-        break;
-
-      case CMD_BARRIER:  // Not implemented
-      case CMD_EMPTY:
-        break;
-
-      case EOC:
-        if (file_num < amount_of_files) {
-            file_num++;
-            set_output_file(files_output[file_num]);
-        }
-        else{
-          close_output_file();
-          ems_terminate();
-          return 0;
-        }
+    if (sharded) {
+        shards_terminate();
     }
-  }
+
+    if (processes) {
+        shared_terminate();
+    }
+
+    ems_terminate(ems);
+    ems_pool_destroy(pool);
+    return ret;
 }
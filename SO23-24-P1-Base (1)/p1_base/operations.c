@@ -1,87 +1,496 @@
-I apologize for the oversight. I misunderstood your request. Let's correct that and only replace the `printf` calls, leaving the `fprintf` calls unchanged. Here's the corrected code:
-
-```c
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
 #include <time.h>
+#include <unistd.h>
 
+#include "epoch.h"
 #include "eventlist.h"
+#include "operations.h"
+#include "rle.h"
+#include "threadpool.h"
 
-int CURRENT_OUTPUT_FILE = NULL;
+// Events with fewer seats are printed seat by seat, larger ones are formatted in parallel chunks.
+#define SHOW_PARALLEL_MIN_SEATS (1 << 18)
+#define SHOW_CHUNK_SEATS (1 << 16)
+#define SHOW_CHUNKS_PER_WRITE 64
+#define SHOW_MAX_SEAT_LENGTH 11  // Digits of the largest reservation id and a separator.
 
-void set_output_file(char* file){
-    if (CURRENT_OUTPUT_FILE != NULL){
-        close(CURRENT_OUTPUT_FILE);
-    }
-    CURRENT_OUTPUT_FILE = open(CURRENT_OUTPUT_FILE, O_WRONLY | O_APPEND);
-}
+struct ems_instance {
+    struct EventList* event_list;
+    unsigned int state_access_delay_ms;
 
-void close_output_file(){
-    close(CURRENT_OUTPUT_FILE);
-}
+    // With snapshot reads, writers publish copies of the rows they change, so SHOW and LIST take no locks.
+    int snapshot_reads;
+    struct EpochDomain* epochs;  /// Readers of the row versions that writers replace.
 
-void write_output(const char* text) {
-    if (CURRENT_OUTPUT_FILE != NULL) {
-         write(CURRENT_OUTPUT_FILE, text, strlen(text));
-    } else {
-        fprintf(stderr, "Error: Output file not set\n");
+    // Large seat arrays are backed by huge pages where the system provides them.
+    int hugepages;
+
+    struct ThreadPool* pool;  /// Helps format large events, NULL if they are formatted by the caller.
+};
+
+// Cooperative tasks must not sleep on their worker thread, so their access delays are only added up.
+static _Thread_local int delays_deferred = 0;
+static _Thread_local unsigned long deferred_delay_ms = 0;
+
+int ems_write_fd(void* context, const char* data, size_t length) {
+    int fd = *(int*)context;
+
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+
+        data += written;
+        length -= (size_t)written;
     }
+
+    return 0;
 }
 
-static struct EventList* event_list = NULL;
-static unsigned int state_access_delay_ms = 0;
+static int write_output(const struct ems_output* out, const char* text) {
+    return out->write(out->context, text, strlen(text));
+}
 
 static struct timespec delay_to_timespec(unsigned int delay_ms) {
     return (struct timespec){delay_ms / 1000, (delay_ms % 1000) * 1000000};
 }
 
-static struct Event* get_event_with_delay(unsigned int event_id) {
-    struct timespec delay = delay_to_timespec(state_access_delay_ms);
+static void access_delay(struct ems_instance* ems) {
+    if (ems->state_access_delay_ms == 0) {
+        return;
+    }
+
+    if (delays_deferred) {
+        deferred_delay_ms += ems->state_access_delay_ms;
+        return;
+    }
+
+    struct timespec delay = delay_to_timespec(ems->state_access_delay_ms);
     nanosleep(&delay, NULL);
+}
+
+static struct Event* get_event_with_delay(struct ems_instance* ems, unsigned int event_id) {
+    access_delay(ems);
+
+    if (ems->snapshot_reads) {
+        return get_event(ems->event_list, event_id);
+    }
 
-    return get_event(event_list, event_id);
+    pthread_rwlock_rdlock(&ems->event_list->lock);
+    struct Event* event = get_event(ems->event_list, event_id);
+    pthread_rwlock_unlock(&ems->event_list->lock);
+
+    return event;
 }
 
-static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
-    struct timespec delay = delay_to_timespec(state_access_delay_ms);
-    nanosleep(&delay, NULL);
+static unsigned int* get_seat(struct Event* event, size_t index) {
+    unsigned int*** pages = event->pending_pages != NULL ? event->pending_pages : event->row_pages;
+
+    if (pages == NULL) {
+        return &event->data[index];
+    }
+
+    return &get_row(event, pages, index / event->cols)[index % event->cols];
+}
+
+static unsigned int* get_seat_with_delay(struct ems_instance* ems, struct Event* event, size_t index) {
+    access_delay(ems);
+    return get_seat(event, index);
+}
+
+/// Copies the page of the row table that holds a row on its first write by the pending write.
+static int copy_page_for_write(struct Event* event, size_t page) {
+    if (event->pending_pages[page] != event->row_pages[page]) {
+        return 0;
+    }
+
+    if (event->num_touched == event->touched_capacity) {
+        size_t capacity = event->touched_capacity ? event->touched_capacity * 2 : 4;
+        size_t* touched = realloc(event->touched_pages, capacity * sizeof(size_t));
+
+        if (touched == NULL) {
+            return 1;
+        }
+
+        event->touched_pages = touched;
+        event->touched_capacity = capacity;
+    }
+
+    unsigned int** copy = malloc(ROW_PAGE_SIZE * sizeof(unsigned int*));
+
+    if (copy == NULL) {
+        return 1;
+    }
+
+    memcpy(copy, event->row_pages[page], page_rows(event, page) * sizeof(unsigned int*));
+    event->pending_pages[page] = copy;
+    event->touched_pages[event->num_touched++] = page;
+
+    return 0;
+}
+
+/// Copies the row of a seat on its first write by the pending write. With snapshot reads, seats are
+/// written to copies that readers cannot see until publish_seat_writes; only the written rows, their
+/// pages and the directory of pages are copied.
+static int copy_row_for_write(struct Event* event, size_t index) {
+    if (event->row_pages == NULL) {
+        return 0;
+    }
+
+    if (event->pending_pages == NULL) {
+        size_t size = num_row_pages(event) * sizeof(unsigned int**);
+        event->pending_pages = malloc(size ? size : 1);
+
+        if (event->pending_pages == NULL) {
+            return 1;
+        }
+
+        memcpy(event->pending_pages, event->row_pages, size);
+    }
+
+    size_t row = index / event->cols;
+    size_t page = row / ROW_PAGE_SIZE;
+
+    if (copy_page_for_write(event, page) != 0) {
+        return 1;
+    }
+
+    unsigned int** rows = event->pending_pages[page];
+
+    if (rows[row % ROW_PAGE_SIZE] != event->row_pages[page][row % ROW_PAGE_SIZE]) {
+        return 0;
+    }
+
+    unsigned int* copy = malloc(event->cols * sizeof(unsigned int));
+
+    if (copy == NULL) {
+        return 1;
+    }
+
+    memcpy(copy, rows[row % ROW_PAGE_SIZE], event->cols * sizeof(unsigned int));
+    rows[row % ROW_PAGE_SIZE] = copy;
+
+    return 0;
+}
+
+/// Makes the pending write visible to readers and retires the versions it replaced, visiting only the
+/// pages it copied.
+static void publish_seat_writes(struct ems_instance* ems, struct Event* event) {
+    if (event->pending_pages == NULL) {
+        return;
+    }
+
+    unsigned int*** old_pages = event->row_pages;
+    atomic_store_explicit(&event->row_pages, event->pending_pages, memory_order_release);
 
-    return &event->data[index];
+    int failed = 0;
+    for (size_t t = 0; t < event->num_touched; t++) {
+        size_t page = event->touched_pages[t];
+        unsigned int** old_rows = old_pages[page];
+
+        for (size_t i = 0; i < page_rows(event, page); i++) {
+            if (old_rows[i] != event->pending_pages[page][i] && !is_original_row(event, old_rows[i])) {
+                failed |= epoch_retire(ems->epochs, &event->limbo, old_rows[i]);
+            }
+        }
+        failed |= epoch_retire(ems->epochs, &event->limbo, old_rows);
+    }
+    failed |= epoch_retire(ems->epochs, &event->limbo, old_pages);
+
+    // A version that could not be retired may still be read, so it is leaked instead of freed.
+    if (failed) {
+        fprintf(stderr, "Error allocating memory for retired rows\n");
+    }
+
+    event->pending_pages = NULL;
+    event->num_touched = 0;
+    epoch_reclaim(ems->epochs, &event->limbo);
+}
+
+/// Drops the pending write, which readers have never seen.
+static void discard_seat_writes(struct Event* event) {
+    if (event->pending_pages == NULL) {
+        return;
+    }
+
+    for (size_t t = 0; t < event->num_touched; t++) {
+        size_t page = event->touched_pages[t];
+        unsigned int** rows = event->pending_pages[page];
+
+        for (size_t i = 0; i < page_rows(event, page); i++) {
+            if (rows[i] != event->row_pages[page][i]) {
+                free(rows[i]);
+            }
+        }
+        free(rows);
+    }
+
+    free(event->pending_pages);
+    event->pending_pages = NULL;
+    event->num_touched = 0;
 }
 
 static size_t seat_index(struct Event* event, size_t row, size_t col) {
     return (row - 1) * event->cols + col - 1;
 }
 
-int ems_init(unsigned int delay_ms) {
-    if (event_list != NULL) {
-        fprintf(stderr, "EMS state has already been initialized\n");
+struct ShowRender {
+    struct ems_instance* ems;
+    struct Event* event;
+    unsigned int*** row_pages;    /// Version of the grid being printed, NULL to print the data of the event.
+    size_t chunk_size;            /// Seats in each chunk, or rows when run-length encoded.
+    size_t chunk_capacity;        /// Bytes reserved in the buffer for each chunk.
+    size_t first_chunk;           /// Chunk formatted by item 0 of the current batch.
+    int rle;                      /// Whether the rows are run-length encoded.
+    char* buffer;
+    struct iovec* chunks;         /// Formatted output of each chunk of the current batch.
+};
+
+static size_t format_seat(char* out, unsigned int seat) {
+    char digits[10];
+    size_t length = 0;
+
+    do {
+        digits[length++] = (char)('0' + seat % 10);
+        seat /= 10;
+    } while (seat != 0);
+
+    for (size_t i = 0; i < length; i++) {
+        out[i] = digits[length - 1 - i];
+    }
+
+    return length;
+}
+
+/// Formats one chunk of the event, exactly as the serial SHOW prints it. Run-length encoded chunks
+/// hold whole rows, as runs may span any number of seats; plain chunks hold a range of seats, which
+/// may start and end in the middle of a row.
+static void render_chunk(void* arg, size_t item) {
+    struct ShowRender* render = arg;
+    struct Event* event = render->event;
+
+    size_t first = (render->first_chunk + item) * render->chunk_size;
+    size_t last = first + render->chunk_size;
+    size_t end = render->rle ? event->rows : event->rows * event->cols;
+    if (last > end) {
+        last = end;
+    }
+
+    char* start = render->buffer + item * render->chunk_capacity;
+    char* out = start;
+
+    for (size_t i = first; i < last && render->rle; i++) {
+        access_delay(render->ems);
+        out += rle_format_row(out, i + 1, get_row(event, render->row_pages, i), event->cols);
+    }
+
+    size_t col = first % event->cols;
+    unsigned int* row = render->rle ? NULL : get_row(event, render->row_pages, first / event->cols);
+
+    for (size_t seat = first; seat < last && !render->rle; seat++) {
+        access_delay(render->ems);
+        out += format_seat(out, row[col]);
+
+        if (++col < event->cols) {
+            *out++ = ' ';
+            continue;
+        }
+
+        *out++ = '\n';
+        col = 0;
+        if (seat + 1 < last) {
+            row = get_row(event, render->row_pages, (seat + 1) / event->cols);
+        }
+    }
+
+    render->chunks[item].iov_base = start;
+    render->chunks[item].iov_len = (size_t)(out - start);
+}
+
+static int write_chunks(const struct ems_output* out, struct iovec* chunks, size_t num_chunks) {
+    for (size_t i = 0; i < num_chunks; i++) {
+        // Run-length encoded chunks are empty when none of their rows has a reservation.
+        if (chunks[i].iov_len > 0 && out->write(out->context, chunks[i].iov_base, chunks[i].iov_len) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int write_rle_header(struct Event* event, const struct ems_output* out) {
+    char header[2 * 20 + 2];
+    return out->write(out->context, header, rle_format_header(header, event->rows, event->cols));
+}
+
+/// Prints an event run-length encoded, a row at a time. Reading a row takes a single state access.
+static int show_rle(struct ems_instance* ems, struct Event* event, unsigned int*** row_pages,
+                    const struct ems_output* out) {
+    char* buffer = malloc(rle_row_bound(event->cols));
+
+    if (buffer == NULL) {
+        fprintf(stderr, "Error allocating memory for event output\n");
         return 1;
     }
 
-    event_list = create_list();
-    state_access_delay_ms = delay_ms;
+    int ret = write_rle_header(event, out);
+    for (size_t i = 0; i < event->rows && ret == 0; i++) {
+        access_delay(ems);
+        size_t length = rle_format_row(buffer, i + 1, get_row(event, row_pages, i), event->cols);
+
+        if (length > 0) {
+            ret = out->write(out->context, buffer, length);
+        }
+    }
+
+    free(buffer);
+    return ret;
+}
+
+/// Prints an event seat by seat, without allocating any memory.
+static int show_plain(struct ems_instance* ems, struct Event* event, unsigned int*** row_pages,
+                      const struct ems_output* out) {
+    int ret = 0;
+
+    for (size_t i = 1; i <= event->rows; i++) {
+        unsigned int* row = get_row(event, row_pages, i - 1);
+
+        for (size_t j = 1; j <= event->cols; j++) {
+            access_delay(ems);
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%u", row[j - 1]);
+            ret |= write_output(out, buffer);
+
+            if (j < event->cols) {
+                ret |= write_output(out, " ");
+            }
+        }
+
+        ret |= write_output(out, "\n");
+    }
+
+    return ret;
+}
+
+/// Prints a large event by formatting batches of chunks on the thread pool, and writing the chunks
+/// of each batch in order. Falls back to the serial SHOW when the chunks cannot be allocated, or
+/// when run-length encoded rows are too wide to be split into chunks of whole rows.
+static int show_parallel(struct ems_instance* ems, struct Event* event, unsigned int*** row_pages,
+                         const struct ems_output* out) {
+    if (out->rle && event->cols > SHOW_CHUNK_SEATS) {
+        return show_rle(ems, event, row_pages, out);
+    }
+
+    struct ShowRender render;
+    render.ems = ems;
+    render.event = event;
+    render.row_pages = row_pages;
+    render.rle = out->rle;
+
+    size_t num_chunks;
+    if (out->rle) {
+        render.chunk_size = SHOW_CHUNK_SEATS / event->cols;
+        render.chunk_capacity = render.chunk_size * rle_row_bound(event->cols);
+        num_chunks = (event->rows + render.chunk_size - 1) / render.chunk_size;
+    } else {
+        render.chunk_size = SHOW_CHUNK_SEATS;
+        render.chunk_capacity = SHOW_CHUNK_SEATS * SHOW_MAX_SEAT_LENGTH;
+        num_chunks = (event->rows * event->cols + SHOW_CHUNK_SEATS - 1) / SHOW_CHUNK_SEATS;
+    }
+
+    size_t max_batch = num_chunks < SHOW_CHUNKS_PER_WRITE ? num_chunks : SHOW_CHUNKS_PER_WRITE;
+    render.buffer = malloc(max_batch * render.chunk_capacity);
+    render.chunks = malloc(max_batch * sizeof(struct iovec));
+
+    if (render.buffer == NULL || render.chunks == NULL) {
+        free(render.buffer);
+        free(render.chunks);
+        return out->rle ? show_rle(ems, event, row_pages, out) : show_plain(ems, event, row_pages, out);
+    }
+
+    int ret = out->rle ? write_rle_header(event, out) : 0;
+
+    for (render.first_chunk = 0; render.first_chunk < num_chunks && ret == 0; render.first_chunk += max_batch) {
+        size_t batch = num_chunks - render.first_chunk;
+        if (batch > max_batch) {
+            batch = max_batch;
+        }
+
+        threadpool_for(ems->pool, render_chunk, &render, batch);
+
+        ret = write_chunks(out, render.chunks, batch);
+    }
+
+    free(render.buffer);
+    free(render.chunks);
+    return ret;
+}
+
+struct ThreadPool* ems_pool_create(unsigned int num_threads) {
+    return threadpool_create(num_threads);
+}
 
-    return event_list == NULL;
+void ems_pool_destroy(struct ThreadPool* pool) {
+    threadpool_destroy(pool);
 }
 
-int ems_terminate() {
-    if (event_list == NULL) {
+struct ems_instance* ems_init(const struct ems_options* options) {
+    struct ems_instance* ems = malloc(sizeof(struct ems_instance));
+
+    if (ems == NULL) {
+        fprintf(stderr, "Error allocating memory for EMS instance\n");
+        return NULL;
+    }
+
+    ems->event_list = create_list();
+    ems->epochs = epoch_create();
+
+    if (ems->event_list == NULL || ems->epochs == NULL) {
+        fprintf(stderr, "Error allocating memory for EMS state\n");
+        free_list(ems->event_list);
+        epoch_destroy(ems->epochs);
+        free(ems);
+        return NULL;
+    }
+
+    ems->state_access_delay_ms = options->delay_ms;
+    ems->snapshot_reads = options->snapshot_reads;
+    ems->hugepages = options->hugepages;
+    ems->pool = options->pool;
+
+    return ems;
+}
+
+int ems_terminate(struct ems_instance* ems) {
+    if (ems == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    free_list(event_list);
+    free_list(ems->event_list);
+    epoch_destroy(ems->epochs);
+    free(ems);
     return 0;
 }
 
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
-    if (event_list == NULL) {
+int ems_create(struct ems_instance* ems, unsigned int event_id, size_t num_rows, size_t num_cols) {
+    if (ems == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    if (get_event_with_delay(event_id) != NULL) {
+    if (get_event_with_delay(ems, event_id) != NULL) {
         fprintf(stderr, "Event already exists\n");
         return 1;
     }
@@ -97,43 +506,66 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
     event->rows = num_rows;
     event->cols = num_cols;
     event->reservations = 0;
-    event->data = malloc(num_rows * num_cols * sizeof(unsigned int));
-
-    if (event->data == NULL) {
+    event->index = NULL;
+    event->index_capacity = 0;
+    event->index_base = 0;
+    event->seat_arena = NULL;
+    event->arena_size = 0;
+    event->arena_capacity = 0;
+    event->live_seats = 0;
+    event->row_pages = NULL;
+    event->pending_pages = NULL;
+    event->touched_pages = NULL;
+    event->num_touched = 0;
+    event->touched_capacity = 0;
+    event->limbo = NULL;
+    event->data = alloc_seats(num_rows * num_cols, ems->hugepages, &event->data_mapping);
+
+    // Rows are only published as versions when readers do not take the lock of the event.
+    if (event->data == NULL || (ems->snapshot_reads && create_row_pages(event) != 0)) {
         fprintf(stderr, "Error allocating memory for event data\n");
+        free_seats(event->data, event->data_mapping);
         free(event);
         return 1;
     }
 
-    for (size_t i = 0; i < num_rows * num_cols; i++) {
-        event->data[i] = 0;
-    }
+    pthread_mutex_init(&event->mutex, NULL);
 
-    if (append_to_list(event_list, event) != 0) {
-        fprintf(stderr, "Error appending event to list\n");
-        free(event->data);
+    pthread_rwlock_wrlock(&ems->event_list->lock);
+
+    // Another thread may have created the same event since the first lookup.
+    if (get_event(ems->event_list, event_id) != NULL) {
+        pthread_rwlock_unlock(&ems->event_list->lock);
+        fprintf(stderr, "Event already exists\n");
+        pthread_mutex_destroy(&event->mutex);
+        free_row_pages(event);
+        free_seats(event->data, event->data_mapping);
         free(event);
         return 1;
     }
 
-    return 0;
-}
-
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
-    if (event_list == NULL) {
-        fprintf(stderr, "EMS state must be initialized\n");
+    if (append_to_list(ems->event_list, event) != 0) {
+        pthread_rwlock_unlock(&ems->event_list->lock);
+        fprintf(stderr, "Error appending event to list\n");
+        pthread_mutex_destroy(&event->mutex);
+        free_row_pages(event);
+        free_seats(event->data, event->data_mapping);
+        free(event);
         return 1;
     }
 
-    struct Event* event = get_event_with_delay(event_id);
+    pthread_rwlock_unlock(&ems->event_list->lock);
 
-    if (event == NULL) {
-        fprintf(stderr, "Event not found\n");
-        return 1;
-    }
-
-    unsigned int reservation_id = ++event->reservations;
+    return 0;
+}
 
+/// Writes the seats of a new reservation to a locked event, stopping at the first seat that is
+/// invalid or already reserved. The seats written are not undone.
+/// @param seats Arena slots returned by prepare_reservation, where the seat indices are recorded.
+/// @param charge_delays Whether every seat access takes the state access delay.
+/// @return Number of seats written, num_seats if the whole reservation was written.
+static size_t write_reservation(struct ems_instance* ems, struct Event* event, unsigned int reservation_id, size_t* seats, size_t num_seats,
+                                size_t* xs, size_t* ys, int charge_delays) {
     size_t i = 0;
     for (; i < num_seats; i++) {
         size_t row = xs[i];
@@ -144,79 +576,316 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
             break;
         }
 
-        if (*get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
+        seats[i] = seat_index(event, row, col);
+
+        if (copy_row_for_write(event, seats[i]) != 0) {
+            fprintf(stderr, "Error allocating memory for seat row\n");
+            break;
+        }
+
+        unsigned int* seat = charge_delays ? get_seat_with_delay(ems, event, seats[i]) : get_seat(event, seats[i]);
+
+        if (*seat != 0) {
             fprintf(stderr, "Seat already reserved\n");
             break;
         }
 
-        *get_seat_with_delay(event, seat_index(event, row, col)) = reservation_id;
+        if (charge_delays) {
+            access_delay(ems);
+        }
+        *seat = reservation_id;
+    }
+
+    return i;
+}
+
+int ems_reserve(struct ems_instance* ems, unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+    if (ems == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
     }
 
+    struct Event* event = get_event_with_delay(ems, event_id);
+
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
+    }
+
+    pthread_mutex_lock(&event->mutex);
+
+    unsigned int reservation_id = ++event->reservations;
+
+    size_t* seats = prepare_reservation(event, reservation_id, num_seats);
+
+    if (seats == NULL) {
+        fprintf(stderr, "Error allocating memory for reservation\n");
+        event->reservations--;
+        pthread_mutex_unlock(&event->mutex);
+        return 1;
+    }
+
+    size_t i = write_reservation(ems, event, reservation_id, seats, num_seats, xs, ys, 1);
+
     if (i < num_seats) {
         event->reservations--;
-        for (size_t j = 0; j < i; j++) {
-            *get_seat_with_delay(event, seat_index(event, xs[j], ys[j])) = 0;
+        if (ems->snapshot_reads) {
+            // Readers never saw the copies, so dropping them undoes the reservation.
+            discard_seat_writes(event);
+        } else {
+            for (size_t j = 0; j < i; j++) {
+                *get_seat_with_delay(ems, event, seats[j]) = 0;
+            }
         }
+        pthread_mutex_unlock(&event->mutex);
         return 1;
     }
 
+    publish_seat_writes(ems, event);
+    commit_reservation(event, reservation_id, num_seats);
+
+    pthread_mutex_unlock(&event->mutex);
+
     return 0;
 }
 
-int ems_show(unsigned int event_id) {
-    if (event_list == NULL) {
+static int compare_by_event(const void* a, const void* b) {
+    const struct ReservationRequest* const* first = a;
+    const struct ReservationRequest* const* second = b;
+
+    if ((*first)->event_id != (*second)->event_id) {
+        return (*first)->event_id < (*second)->event_id ? -1 : 1;
+    }
+
+    // Requests of the same event keep their order.
+    return *first < *second ? -1 : *first > *second;
+}
+
+/// Creates the reservations of a batch that belong to one locked event, in a single pass over its
+/// seats that takes one state access delay.
+static void reserve_locked_batch(struct ems_instance* ems, struct Event* event, struct ReservationRequest** requests,
+                                 size_t num_requests) {
+    access_delay(ems);
+
+    for (size_t r = 0; r < num_requests; r++) {
+        struct ReservationRequest* request = requests[r];
+        unsigned int reservation_id = ++event->reservations;
+
+        size_t* seats = prepare_reservation(event, reservation_id, request->num_seats);
+
+        if (seats == NULL) {
+            fprintf(stderr, "Error allocating memory for reservation\n");
+            event->reservations--;
+            request->result = 1;
+            continue;
+        }
+
+        size_t i = write_reservation(ems, event, reservation_id, seats, request->num_seats, request->xs, request->ys, 0);
+
+        if (i < request->num_seats) {
+            // The batch shares its row copies, so only the seats of this reservation are undone.
+            event->reservations--;
+            for (size_t j = 0; j < i; j++) {
+                *get_seat(event, seats[j]) = 0;
+            }
+            request->result = 1;
+            continue;
+        }
+
+        commit_reservation(event, reservation_id, request->num_seats);
+        request->result = 0;
+    }
+
+    publish_seat_writes(ems, event);
+}
+
+int ems_reserve_batch(struct ems_instance* ems, struct ReservationRequest* requests, size_t num_requests) {
+    if (ems == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct ReservationRequest** sorted = malloc(num_requests * sizeof(struct ReservationRequest*));
+
+    if (sorted == NULL) {
+        fprintf(stderr, "Error allocating memory for batch\n");
+        return 1;
+    }
+
+    for (size_t r = 0; r < num_requests; r++) {
+        sorted[r] = &requests[r];
+    }
+    qsort(sorted, num_requests, sizeof(struct ReservationRequest*), compare_by_event);
+
+    int ret = 0;
+    for (size_t first = 0, last; first < num_requests; first = last) {
+        for (last = first + 1; last < num_requests && sorted[last]->event_id == sorted[first]->event_id; last++)
+            ;
+
+        struct Event* event = get_event_with_delay(ems, sorted[first]->event_id);
+
+        if (event == NULL) {
+            fprintf(stderr, "Event not found\n");
+            for (size_t r = first; r < last; r++) {
+                sorted[r]->result = 1;
+            }
+            ret = 1;
+            continue;
+        }
+
+        pthread_mutex_lock(&event->mutex);
+        reserve_locked_batch(ems, event, &sorted[first], last - first);
+        pthread_mutex_unlock(&event->mutex);
+
+        for (size_t r = first; r < last; r++) {
+            ret |= sorted[r]->result;
+        }
+    }
+
+    free(sorted);
+    return ret;
+}
+
+int ems_cancel(struct ems_instance* ems, unsigned int event_id, unsigned int reservation_id) {
+    if (ems == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    struct Event* event = get_event_with_delay(event_id);
+    struct Event* event = get_event_with_delay(ems, event_id);
 
     if (event == NULL) {
         fprintf(stderr, "Event not found\n");
         return 1;
     }
 
-    for (size_t i = 1; i <= event->rows; i++) {
-        for (size_t j = 1; j <= event->cols; j++) {
-            unsigned int* seat = get_seat_with_delay(event, seat_index(event, i, j));
-            char buffer[32];
-            snprintf(buffer, sizeof(buffer), "%u", *seat);
-            write_output(buffer);
+    pthread_mutex_lock(&event->mutex);
 
-            if (j < event->cols) {
-                write_output(" ");
-            }
+    struct Reservation* reservation = get_reservation(event, reservation_id);
+
+    if (reservation == NULL || reservation->num_seats == 0) {
+        pthread_mutex_unlock(&event->mutex);
+        fprintf(stderr, "Reservation not found\n");
+        return 1;
+    }
+
+    // Only the seats recorded in the index are touched, the grid is never scanned.
+    size_t* seats = &event->seat_arena[reservation->offset];
+    for (size_t i = 0; i < reservation->num_seats; i++) {
+        if (copy_row_for_write(event, seats[i]) != 0) {
+            discard_seat_writes(event);
+            pthread_mutex_unlock(&event->mutex);
+            fprintf(stderr, "Error allocating memory for seat row\n");
+            return 1;
         }
 
-        write_output("\n");
+        *get_seat_with_delay(ems, event, seats[i]) = 0;
     }
 
+    publish_seat_writes(ems, event);
+    cancel_reservation(event, reservation);
+
+    pthread_mutex_unlock(&event->mutex);
+
     return 0;
 }
 
-int ems_list_events() {
-    if (event_list == NULL) {
+int ems_show(struct ems_instance* ems, unsigned int event_id, const struct ems_output* out) {
+    if (ems == NULL) {
         fprintf(stderr, "EMS state must be initialized\n");
         return 1;
     }
 
-    if (event_list->head == NULL) {
-        write_output("No events\n");
-        return 0;
+    struct Event* event = get_event_with_delay(ems, event_id);
+
+    if (event == NULL) {
+        fprintf(stderr, "Event not found\n");
+        return 1;
     }
 
-    struct ListNode* current = event_list->head;
-    while (current != NULL) {
+    // With snapshot reads no lock is taken, and the version of the grid current at this point is printed.
+    struct EpochRecord* reader = NULL;
+    if (ems->snapshot_reads) {
+        reader = epoch_enter(ems->epochs);
+        if (reader == NULL) {
+            fprintf(stderr, "Error allocating memory for epoch record\n");
+            return 1;
+        }
+    } else {
+        pthread_mutex_lock(&event->mutex);
+    }
+
+    unsigned int*** row_pages = atomic_load_explicit(&event->row_pages, memory_order_acquire);
+    int ret;
+
+    // Deferred delays belong to the calling task, so pool threads must not take them.
+    // The run-length encoded header is only written once the buffers of the rows are allocated.
+    if (event->rows * event->cols >= SHOW_PARALLEL_MIN_SEATS && event->cols > 0 && !delays_deferred) {
+        ret = show_parallel(ems, event, row_pages, out);
+    } else if (out->rle) {
+        ret = show_rle(ems, event, row_pages, out);
+    } else {
+        ret = show_plain(ems, event, row_pages, out);
+    }
+
+    if (ems->snapshot_reads) {
+        epoch_exit(reader);
+    } else {
+        pthread_mutex_unlock(&event->mutex);
+    }
+
+    if (ret != 0) {
+        fprintf(stderr, "Error writing event output\n");
+    }
+
+    return ret;
+}
+
+int ems_list_events(struct ems_instance* ems, const struct ems_output* out) {
+    if (ems == NULL) {
+        fprintf(stderr, "EMS state must be initialized\n");
+        return 1;
+    }
+
+    struct EventList* list = ems->event_list;
+
+    // Events are only ever appended, so without the lock LIST prints the events created until it started.
+    if (!ems->snapshot_reads) {
+        pthread_rwlock_rdlock(&list->lock);
+    }
+
+    int ret = 0;
+
+    if (list->head == NULL) {
+        ret = write_output(out, "No events\n");
+    }
+
+    struct ListNode* current = list->head;
+    while (current != NULL && ret == 0) {
         char buffer[32];
         snprintf(buffer, sizeof(buffer), "Event: %u\n", (current->event)->id);
-        write_output(buffer);
+        ret = write_output(out, buffer);
         current = current->next;
     }
 
-    return 0;
+    if (!ems->snapshot_reads) {
+        pthread_rwlock_unlock(&list->lock);
+    }
+
+    return ret;
 }
 
 void ems_wait(unsigned int delay_ms) {
     struct timespec delay = delay_to_timespec(delay_ms);
     nanosleep(&delay, NULL);
 }
+
+void ems_defer_delays(int enable) {
+    delays_deferred = enable;
+}
+
+unsigned long ems_take_deferred_delay() {
+    unsigned long delay_ms = deferred_delay_ms;
+    deferred_delay_ms = 0;
+    return delay_ms;
+}
@@ -3,40 +3,127 @@
 
 #include <stddef.h>
 
-/// Initializes the EMS state.
-/// @param delay_ms State access delay in milliseconds.
-/// @return 0 if the EMS state was initialized successfully, 1 otherwise.
-int ems_init(unsigned int delay_ms);
+// An EMS instance holds its events and settings behind an opaque handle that every call takes, so
+// a process may run any number of independent instances. Instances share no mutable state, and
+// each one may be used by several threads at once.
 
-/// Destroys the EMS state.
-int ems_terminate();
+struct ems_instance;
+struct ThreadPool;
+
+// libems is built with hidden visibility, so only the functions marked with EMS_API are exported.
+#define EMS_API __attribute__((visibility("default")))
+
+struct ems_options {
+  unsigned int delay_ms;    /// State access delay in milliseconds.
+  int snapshot_reads;       /// Whether SHOW and LIST read snapshots without locks, see ems_show.
+  int hugepages;            /// Whether the seats of large events are backed by huge pages.
+  struct ThreadPool *pool;  /// Pool formatting large SHOWs, NULL to format them on the calling thread.
+};
+
+/// Receives the output of SHOW and LIST, in order.
+/// @param context Context of the output.
+/// @param data Output to be written.
+/// @param length Number of bytes of output.
+/// @return 0 if the output was written successfully, 1 otherwise.
+typedef int (*ems_write_fn)(void *context, const char *data, size_t length);
+
+struct ems_output {
+  ems_write_fn write;  /// Called with each piece of output.
+  void *context;       /// Passed to write.
+  int rle;             /// Whether SHOW prints events run-length encoded, see rle.h.
+};
+
+/// Output writer for ems_output, whose context points to the file descriptor to write to.
+EMS_API int ems_write_fd(void *context, const char *data, size_t length);
+
+/// Creates a pool of threads that format large SHOWs, see ems_options.
+/// @param num_threads Number of threads helping the callers, may be 0.
+/// @return Pointer to the pool, NULL on failure.
+EMS_API struct ThreadPool *ems_pool_create(unsigned int num_threads);
+
+/// Destroys a pool. Must only be called when no instance is using it.
+/// @param pool Pool to be destroyed.
+EMS_API void ems_pool_destroy(struct ThreadPool *pool);
+
+/// Creates an EMS instance.
+/// @param options Settings of the instance. With snapshot reads, RESERVE and CANCEL publish copies
+/// of the rows they change, so SHOW and LIST take no locks. Huge pages come from the reserved huge
+/// page pool if the system has one, and are transparent huge pages otherwise. The pool may be
+/// shared by several instances.
+/// @return Handle of the instance, NULL on failure.
+EMS_API struct ems_instance *ems_init(const struct ems_options *options);
+
+/// Destroys an EMS instance. Must only be called when no thread is using it.
+/// @param ems Instance to be destroyed.
+/// @return 0 if the instance was destroyed successfully, 1 otherwise.
+EMS_API int ems_terminate(struct ems_instance *ems);
 
 /// Creates a new event with the given id and dimensions.
+/// @param ems Instance to create the event in.
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
 /// @param num_cols Number of columns of the event to be created.
 /// @return 0 if the event was created successfully, 1 otherwise.
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+EMS_API int ems_create(struct ems_instance *ems, unsigned int event_id, size_t num_rows, size_t num_cols);
 
 /// Creates a new reservation for the given event.
+/// @param ems Instance the event belongs to.
 /// @param event_id Id of the event to create a reservation for.
 /// @param num_seats Number of seats to reserve.
 /// @param xs Array of rows of the seats to reserve.
 /// @param ys Array of columns of the seats to reserve.
 /// @return 0 if the reservation was created successfully, 1 otherwise.
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+EMS_API int ems_reserve(struct ems_instance *ems, unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+
+struct ReservationRequest {
+  unsigned int event_id;  /// Id of the event to create a reservation for.
+  size_t num_seats;       /// Number of seats to reserve.
+  size_t *xs;             /// Array of rows of the seats to reserve.
+  size_t *ys;             /// Array of columns of the seats to reserve.
+  int result;             /// Set to 0 if the reservation was created successfully, 1 otherwise.
+};
+
+/// Creates a batch of reservations. The requests are grouped by event, and each event is looked up
+/// and locked once while its reservations are made in order in a single pass over its seats. Every
+/// reservation is still created completely or not at all, and gets its own id.
+/// @param ems Instance the events belong to.
+/// @param requests Array of reservations to create, whose results are set.
+/// @param num_requests Number of reservations.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+EMS_API int ems_reserve_batch(struct ems_instance *ems, struct ReservationRequest *requests, size_t num_requests);
+
+/// Cancels a reservation of the given event, freeing its seats.
+/// @param ems Instance the event belongs to.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+EMS_API int ems_cancel(struct ems_instance *ems, unsigned int event_id, unsigned int reservation_id);
 
 /// Prints the given event.
+/// @param ems Instance the event belongs to.
 /// @param event_id Id of the event to print.
+/// @param out Output to print the event to.
 /// @return 0 if the event was printed successfully, 1 otherwise.
-int ems_show(unsigned int event_id);
+EMS_API int ems_show(struct ems_instance *ems, unsigned int event_id, const struct ems_output *out);
 
 /// Prints all the events.
+/// @param ems Instance whose events are printed.
+/// @param out Output to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
-int ems_list_events();
+EMS_API int ems_list_events(struct ems_instance *ems, const struct ems_output *out);
 
 /// Waits for a given amount of time.
 /// @param delay_us Delay in milliseconds.
-void ems_wait(unsigned int delay_ms);
+EMS_API void ems_wait(unsigned int delay_ms);
+
+/// Makes the state access delays of the calling thread accumulate instead of sleeping, whichever
+/// instance the commands run on. Used by cooperative tasks, which suspend for the accumulated delay
+/// after each command.
+/// @param enable 1 to accumulate the delays, 0 to sleep on every access.
+EMS_API void ems_defer_delays(int enable);
+
+/// Returns and clears the state access delay accumulated by the calling thread.
+/// @return Accumulated delay in milliseconds.
+EMS_API unsigned long ems_take_deferred_delay();
 
 #endif  // EMS_OPERATIONS_H
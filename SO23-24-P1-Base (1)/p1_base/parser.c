@@ -51,13 +51,25 @@ enum Command get_next(int fd) {
   }
 
   switch (buf[0]) {
-    case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
-        cleanup(fd);
-        return CMD_INVALID;
+    case 'C': {
+      ssize_t len = read(fd, buf + 1, 6);
+
+      if (len == 6 && strncmp(buf, "CREATE ", 7) == 0) {
+        return CMD_CREATE;
       }
 
-      return CMD_CREATE;
+      if (len == 6 && strncmp(buf, "CANCEL ", 7) == 0) {
+        return CMD_CANCEL;
+      }
+
+      // COMMIT takes the whole line, which may be the last one of the file and lack the newline.
+      if ((len == 6 && strncmp(buf, "COMMIT\n", 7) == 0) || (len == 5 && strncmp(buf, "COMMIT", 6) == 0)) {
+        return CMD_COMMIT;
+      }
+
+      cleanup(fd);
+      return CMD_INVALID;
+    }
 
     case 'R':
       if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
@@ -75,6 +87,14 @@ enum Command get_next(int fd) {
 
       return CMD_SHOW;
 
+    case 'F':
+      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "FORMAT ", 7) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_FORMAT;
+
     case 'L':
       if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
         cleanup(fd);
@@ -89,12 +109,26 @@ enum Command get_next(int fd) {
       return CMD_LIST_EVENTS;
 
     case 'B':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "BARRIER", 7) != 0) {
+      if (read(fd, buf + 1, 4) != 4) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (strncmp(buf, "BEGIN", 5) == 0) {
+        if (read(fd, buf + 5, 1) == 1 && buf[5] != '\n') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_BEGIN;
+      }
+
+      if (read(fd, buf + 5, 2) != 2 || strncmp(buf, "BARRIER", 7) != 0) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      if (read(fd, buf + 7, 1) != 0 && buf[7] != '\n') {
+      if (read(fd, buf + 7, 1) == 1 && buf[7] != '\n') {
         cleanup(fd);
         return CMD_INVALID;
       }
@@ -219,6 +253,22 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   return num_coords;
 }
 
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  char ch;
+
+  if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (read_uint(fd, reservation_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
 int parse_show(int fd, unsigned int *event_id) {
   char ch;
 
@@ -230,6 +280,30 @@ int parse_show(int fd, unsigned int *event_id) {
   return 0;
 }
 
+int parse_format(int fd, int *rle) {
+  char buf[8];
+  size_t len = 0;
+  char ch;
+
+  while (read(fd, &ch, 1) == 1 && ch != '\n') {
+    if (len == sizeof(buf)) {
+      cleanup(fd);
+      return 1;
+    }
+    buf[len++] = ch;
+  }
+
+  if (len == 3 && strncmp(buf, "RLE", 3) == 0) {
+    *rle = 1;
+  } else if (len == 5 && strncmp(buf, "PLAIN", 5) == 0) {
+    *rle = 0;
+  } else {
+    return 1;
+  }
+
+  return 0;
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
@@ -257,3 +331,13 @@ int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
     return -1;
   }
 }
+
+const struct CommandParser text_parser = {
+    .get_next = get_next,
+    .parse_create = parse_create,
+    .parse_reserve = parse_reserve,
+    .parse_cancel = parse_cancel,
+    .parse_show = parse_show,
+    .parse_format = parse_format,
+    .parse_wait = parse_wait,
+};
@@ -6,10 +6,14 @@
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_CANCEL,
   CMD_SHOW,
+  CMD_FORMAT,
   CMD_LIST_EVENTS,
   CMD_BARRIER,
   CMD_WAIT,
+  CMD_BEGIN,
+  CMD_COMMIT,
   CMD_HELP,
   CMD_EMPTY,
   CMD_INVALID,
@@ -38,12 +42,25 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
 /// @return Number of coordinates read. 0 on failure.
 size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
+/// Parses a CANCEL command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses a FORMAT command.
+/// @param fd File descriptor to read from.
+/// @param rle Pointer to the variable to store whether SHOW uses the run-length encoded output in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_format(int fd, int *rle);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
@@ -51,4 +68,18 @@ int parse_show(int fd, unsigned int *event_id);
 /// @return 0 if no thread was specified, 1 if a thread was specified, -1 on error.
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id);
 
+/// Set of functions that read commands from a job file of a given format.
+struct CommandParser {
+  enum Command (*get_next)(int fd);
+  int (*parse_create)(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+  size_t (*parse_reserve)(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
+  int (*parse_cancel)(int fd, unsigned int *event_id, unsigned int *reservation_id);
+  int (*parse_show)(int fd, unsigned int *event_id);
+  int (*parse_format)(int fd, int *rle);
+  int (*parse_wait)(int fd, unsigned int *delay, unsigned int *thread_id);
+};
+
+/// Parser for text job files.
+extern const struct CommandParser text_parser;
+
 #endif  // EMS_PARSER_H
@@ -0,0 +1,32 @@
+#include "reservation.h"
+
+#include <string.h>
+
+int should_compact_reservations(size_t arena_size, size_t live_seats, size_t num_entries) {
+  size_t dead_seats = arena_size - live_seats;
+  return arena_size >= ARENA_COMPACT_MIN_SIZE && dead_seats > live_seats && dead_seats * 2 >= num_entries;
+}
+
+size_t pack_reservations(const struct Reservation *index, size_t num_entries, const size_t *arena,
+                         struct Reservation *new_index, size_t *new_arena, size_t *new_num_entries) {
+  size_t first_live = 0;
+  while (first_live < num_entries && index[first_live].num_seats == 0) first_live++;
+
+  // Reservations are laid out in id order, so when packing in place the seats and the entries only
+  // ever move towards the front, over ones that were already moved.
+  size_t arena_size = 0;
+  for (size_t i = first_live; i < num_entries; i++) {
+    struct Reservation reservation = index[i];
+    memmove(&new_arena[arena_size], &arena[reservation.offset], reservation.num_seats * sizeof(size_t));
+    new_index[i - first_live] = (struct Reservation){arena_size, reservation.num_seats};
+    arena_size += reservation.num_seats;
+  }
+
+  *new_num_entries = num_entries - first_live;
+  return arena_size;
+}
+
+size_t shrunk_capacity(size_t capacity, size_t used, size_t min_capacity) {
+  while (capacity > min_capacity && capacity / 4 >= used) capacity /= 2;
+  return capacity;
+}
@@ -0,0 +1,48 @@
+#ifndef EMS_RESERVATION_H
+#define EMS_RESERVATION_H
+
+#include <stddef.h>
+
+// Bookkeeping of the reservations of an event, shared by the in-process and the shared-memory
+// states. Each reservation has an entry in an index, ordered by id, pointing to its seats in an
+// arena where the seats of the reservations are stored contiguously, in id order. Cancelling a
+// reservation only empties its entry, so the index and the arena are compacted from time to time.
+
+#define ARENA_COMPACT_MIN_SIZE 1024  // Arenas with fewer seats are never compacted.
+
+struct Reservation {
+  size_t offset;     /// Position of the reservation's first seat in the event's seat arena.
+  size_t num_seats;  /// Number of seats held by the reservation, 0 once cancelled.
+};
+
+/// Checks whether the index and the arena of an event should be compacted. Compacting costs time
+/// linear in the arena and the index, which is paid for by the cancelled seats it reclaims: there
+/// must be more of them than live seats, and at least half as many as index entries.
+/// @param arena_size Number of seats in the arena.
+/// @param live_seats Number of seats in the arena that belong to live reservations.
+/// @param num_entries Number of entries in the index.
+/// @return 1 if the reservations should be compacted, 0 otherwise.
+int should_compact_reservations(size_t arena_size, size_t live_seats, size_t num_entries);
+
+/// Drops the index entries up to the oldest live reservation, and packs the seats of the remaining
+/// reservations at the front of the arena. Later entries are kept even if cancelled, so that every
+/// id still maps to its own entry.
+/// @param index Index to compact, with num_entries entries.
+/// @param num_entries Number of entries in the index.
+/// @param arena Arena with the seats of the reservations.
+/// @param new_index Index to write the remaining entries to. May be index.
+/// @param new_arena Arena to pack the seats into. May be arena.
+/// @param new_num_entries Set to the number of entries written to new_index.
+/// @return Number of seats written to new_arena.
+size_t pack_reservations(const struct Reservation *index, size_t num_entries, const size_t *arena,
+                         struct Reservation *new_index, size_t *new_arena, size_t *new_num_entries);
+
+/// Returns the capacity an array should be shrunk to, halving it while it is at least four times
+/// the number of elements in use.
+/// @param capacity Current capacity of the array.
+/// @param used Number of elements in use.
+/// @param min_capacity Capacity the array is never shrunk below.
+/// @return New capacity of the array.
+size_t shrunk_capacity(size_t capacity, size_t used, size_t min_capacity);
+
+#endif  // EMS_RESERVATION_H
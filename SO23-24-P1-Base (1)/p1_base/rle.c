@@ -0,0 +1,110 @@
+#include "rle.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Runs are found comparing whole words of seats against the id of the run, so that long runs are
+// scanned 8 seats per branch. memcpy keeps the loads free of alignment and aliasing issues, and
+// compiles to plain word loads.
+
+#define MAX_NUMBER_LENGTH 20
+#define MAX_ID_LENGTH 10  // Digits of the largest reservation id.
+
+static size_t format_number(char *out, size_t value) {
+  char digits[MAX_NUMBER_LENGTH];
+  size_t length = 0;
+
+  do {
+    digits[length++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  for (size_t i = 0; i < length; i++) {
+    out[i] = digits[length - 1 - i];
+  }
+
+  return length;
+}
+
+static uint64_t load_pair(const unsigned int *seats) {
+  uint64_t pair;
+  memcpy(&pair, seats, sizeof(pair));
+  return pair;
+}
+
+/// Checks whether every seat of a row is free, without branching per seat.
+static int row_is_free(const unsigned int *seats, size_t cols) {
+  uint64_t reserved = 0;
+  size_t i = 0;
+
+  for (; i + 2 <= cols; i += 2) {
+    reserved |= load_pair(&seats[i]);
+  }
+
+  if (i < cols) {
+    reserved |= seats[i];
+  }
+
+  return reserved == 0;
+}
+
+/// Finds the end of the run of equal ids that starts at a seat.
+static size_t run_end(const unsigned int *seats, size_t start, size_t cols) {
+  unsigned int id = seats[start];
+  uint64_t pattern = (uint64_t)id << 32 | id;
+  size_t i = start + 1;
+
+  for (; i + 8 <= cols; i += 8) {
+    uint64_t diff = (load_pair(&seats[i]) ^ pattern) | (load_pair(&seats[i + 2]) ^ pattern) |
+                    (load_pair(&seats[i + 4]) ^ pattern) | (load_pair(&seats[i + 6]) ^ pattern);
+    if (diff != 0) {
+      break;
+    }
+  }
+
+  for (; i + 2 <= cols && load_pair(&seats[i]) == pattern; i += 2)
+    ;
+
+  // The run ends within the next two seats.
+  for (; i < cols && seats[i] == id; i++)
+    ;
+
+  return i;
+}
+
+size_t rle_row_bound(size_t cols) {
+  // The row number and ":", the runs and the newline. A run of n seats takes " <id>x<n>", at most
+  // 13 bytes for a single seat and never more than 13 bytes per seat for longer runs.
+  return MAX_NUMBER_LENGTH + 1 + cols * (MAX_ID_LENGTH + 3) + 1;
+}
+
+size_t rle_format_header(char *out, size_t rows, size_t cols) {
+  size_t length = format_number(out, rows);
+  out[length++] = ' ';
+  length += format_number(out + length, cols);
+  out[length++] = '\n';
+  return length;
+}
+
+size_t rle_format_row(char *out, size_t row, const unsigned int *seats, size_t cols) {
+  if (row_is_free(seats, cols)) {
+    return 0;
+  }
+
+  size_t length = format_number(out, row);
+  out[length++] = ':';
+
+  for (size_t start = 0; start < cols;) {
+    size_t end = run_end(seats, start, cols);
+
+    out[length++] = ' ';
+    length += format_number(out + length, seats[start]);
+    out[length++] = 'x';
+    length += format_number(out + length, end - start);
+
+    start = end;
+  }
+
+  out[length++] = '\n';
+  return length;
+}
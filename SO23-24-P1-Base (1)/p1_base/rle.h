@@ -0,0 +1,31 @@
+#ifndef EMS_RLE_H
+#define EMS_RLE_H
+
+#include <stddef.h>
+
+// Run-length encoded SHOW output. An event is printed as a "<rows> <cols>" line followed by one
+// line per row with a reserved seat, listing the runs of equal reservation ids in the row:
+//   <row>: <id>x<count> <id>x<count> ...
+// Rows where every seat is free are skipped.
+
+/// Upper bound of the length of the output of rle_format_row.
+/// @param cols Number of seats in the row.
+/// @return Maximum number of bytes written for a row.
+size_t rle_row_bound(size_t cols);
+
+/// Formats the header line of an event.
+/// @param out Buffer of at least 2 * 20 + 2 bytes to write the line to.
+/// @param rows Number of rows of the event.
+/// @param cols Number of columns of the event.
+/// @return Number of bytes written.
+size_t rle_format_header(char *out, size_t rows, size_t cols);
+
+/// Formats a row as runs of equal reservation ids.
+/// @param out Buffer of at least rle_row_bound(cols) bytes to write the row to.
+/// @param row Number of the row, starting at 1.
+/// @param seats Reservation ids of the seats of the row.
+/// @param cols Number of seats in the row.
+/// @return Number of bytes written, 0 if every seat of the row is free.
+size_t rle_format_row(char *out, size_t row, const unsigned int *seats, size_t cols);
+
+#endif  // EMS_RLE_H
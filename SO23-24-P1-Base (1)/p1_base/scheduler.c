@@ -0,0 +1,325 @@
+#include "scheduler.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Hierarchical timer wheel with a 1 ms tick. Level i holds the tasks that expire within
+// WHEEL_SLOTS^(i + 1) ticks and is cascaded into the lower levels as time advances.
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1UL << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+
+struct Task {
+  task_fn fn;
+  void *arg;
+  unsigned long expiry;  /// Tick at which the task becomes runnable again while suspended.
+  struct Task *next;
+};
+
+static struct Task *wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static unsigned long wheel_now = 0;  /// Last tick processed by the wheel.
+static size_t num_suspended = 0;     /// Number of tasks in the wheel.
+
+static struct Task *ready_head = NULL;
+static struct Task *ready_tail = NULL;
+static size_t num_tasks = 0;  /// Number of tasks that have not finished.
+
+static unsigned int num_workers = 0;
+static struct timespec start_time;
+
+static pthread_mutex_t scheduler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ready_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t timer_cond = PTHREAD_COND_INITIALIZER;
+
+static unsigned long now_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  long ms = (now.tv_sec - start_time.tv_sec) * 1000 + (now.tv_nsec - start_time.tv_nsec) / 1000000;
+  return ms > 0 ? (unsigned long)ms : 0;
+}
+
+static void push_ready(struct Task *task) {
+  task->next = NULL;
+  if (ready_tail == NULL) {
+    ready_head = task;
+  } else {
+    ready_tail->next = task;
+  }
+  ready_tail = task;
+}
+
+static struct Task *pop_ready(void) {
+  struct Task *task = ready_head;
+  if (task != NULL) {
+    ready_head = task->next;
+    if (ready_head == NULL) {
+      ready_tail = NULL;
+    }
+  }
+  return task;
+}
+
+/// Places a suspended task in the slot of the wheel matching its expiry.
+/// @return 1 if the task had already expired and was made runnable instead, 0 otherwise.
+static size_t wheel_insert(struct Task *task) {
+  if (task->expiry <= wheel_now) {
+    push_ready(task);
+    return 1;
+  }
+
+  unsigned long delta = task->expiry - wheel_now;
+  unsigned int level = 0;
+  while (level < WHEEL_LEVELS - 1 && delta >= 1UL << (WHEEL_BITS * (level + 1))) {
+    level++;
+  }
+
+  unsigned long slot;
+  if (delta >= 1UL << (WHEEL_BITS * WHEEL_LEVELS)) {
+    // Beyond the range of the wheel: park it in the slot cascaded last, it is re-inserted from there.
+    slot = ((wheel_now >> (WHEEL_BITS * level)) - 1) & WHEEL_MASK;
+  } else {
+    slot = (task->expiry >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  }
+
+  task->next = wheel[level][slot];
+  wheel[level][slot] = task;
+  return 0;
+}
+
+/// Advances the wheel by one tick.
+/// @return Number of tasks that became runnable.
+static size_t wheel_advance(void) {
+  size_t woken = 0;
+  wheel_now++;
+
+  // Cascade the higher levels first so that their tasks can still expire in this tick.
+  for (unsigned int level = WHEEL_LEVELS - 1; level > 0; level--) {
+    if ((wheel_now & ((1UL << (WHEEL_BITS * level)) - 1)) != 0) {
+      continue;
+    }
+
+    unsigned long slot = (wheel_now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    struct Task *task = wheel[level][slot];
+    wheel[level][slot] = NULL;
+
+    while (task != NULL) {
+      struct Task *next = task->next;
+      woken += wheel_insert(task);
+      task = next;
+    }
+  }
+
+  struct Task *task = wheel[0][wheel_now & WHEEL_MASK];
+  wheel[0][wheel_now & WHEEL_MASK] = NULL;
+
+  while (task != NULL) {
+    struct Task *next = task->next;
+    push_ready(task);
+    woken++;
+    task = next;
+  }
+
+  return woken;
+}
+
+/// Returns the first tick after the current one at which the wheel has work to do, either a level 0
+/// slot whose tasks expire or a higher level slot to be cascaded. Nothing happens in the ticks before.
+static unsigned long wheel_next_tick(void) {
+  unsigned long next = ULONG_MAX;
+
+  for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+    // A slot of this level is processed every 2^shift ticks.
+    unsigned int shift = WHEEL_BITS * level;
+    unsigned long tick = ((wheel_now >> shift) + 1) << shift;
+
+    for (unsigned long i = 0; i < WHEEL_SLOTS && tick < next; i++, tick += 1UL << shift) {
+      if (wheel[level][(tick >> shift) & WHEEL_MASK] != NULL) {
+        next = tick;
+      }
+    }
+  }
+
+  return next;
+}
+
+/// Converts a tick into an absolute CLOCK_REALTIME time, as taken by pthread_cond_timedwait.
+static struct timespec tick_deadline(unsigned long tick) {
+  unsigned long now = now_ms();
+  unsigned long delay_ms = tick > now ? tick - now : 0;
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += (time_t)(delay_ms / 1000);
+  deadline.tv_nsec += (long)(delay_ms % 1000) * 1000000;
+  if (deadline.tv_nsec >= 1000000000) {
+    deadline.tv_sec++;
+    deadline.tv_nsec -= 1000000000;
+  }
+
+  return deadline;
+}
+
+static void suspend(struct Task *task, unsigned long delay_ms) {
+  unsigned long now = now_ms();
+
+  if (num_suspended == 0 && now > wheel_now) {
+    // The wheel is empty, so it can jump to the current time instead of catching up tick by tick.
+    wheel_now = now;
+  }
+
+  task->expiry = now + delay_ms;
+  if (wheel_insert(task)) {
+    pthread_cond_signal(&ready_cond);
+    return;
+  }
+
+  num_suspended++;
+  pthread_cond_signal(&timer_cond);
+}
+
+static void *timer_main(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&scheduler_lock);
+  while (num_tasks > 0) {
+    if (num_suspended == 0) {
+      pthread_cond_wait(&timer_cond, &scheduler_lock);
+      continue;
+    }
+
+    unsigned long now = now_ms();
+    size_t woken = 0;
+    while (num_suspended > woken) {
+      unsigned long next = wheel_next_tick();
+      if (next > now) {
+        break;
+      }
+
+      // The wheel skips the ticks in which nothing happens.
+      wheel_now = next - 1;
+      woken += wheel_advance();
+    }
+
+    if (woken > 0) {
+      num_suspended -= woken;
+      pthread_cond_broadcast(&ready_cond);
+    }
+
+    // Sleeps until the next tick with work to do, or until a task is suspended or the last one ends.
+    if (num_suspended > 0) {
+      struct timespec deadline = tick_deadline(wheel_next_tick());
+      pthread_cond_timedwait(&timer_cond, &scheduler_lock, &deadline);
+    }
+  }
+  pthread_mutex_unlock(&scheduler_lock);
+
+  return NULL;
+}
+
+static void *worker_main(void *arg) {
+  (void)arg;
+
+  pthread_mutex_lock(&scheduler_lock);
+  while (1) {
+    while (ready_head == NULL && num_tasks > 0) {
+      pthread_cond_wait(&ready_cond, &scheduler_lock);
+    }
+
+    struct Task *task = pop_ready();
+    if (task == NULL) {
+      break;
+    }
+
+    pthread_mutex_unlock(&scheduler_lock);
+    long delay = task->fn(task->arg);
+    pthread_mutex_lock(&scheduler_lock);
+
+    if (delay == TASK_DONE) {
+      free(task);
+      if (--num_tasks == 0) {
+        pthread_cond_broadcast(&ready_cond);
+        pthread_cond_signal(&timer_cond);
+      }
+    } else if (delay == 0) {
+      push_ready(task);
+    } else {
+      suspend(task, (unsigned long)delay);
+    }
+  }
+  pthread_mutex_unlock(&scheduler_lock);
+
+  return NULL;
+}
+
+int scheduler_init(unsigned int workers) {
+  if (workers == 0) {
+    fprintf(stderr, "Scheduler needs at least one worker\n");
+    return 1;
+  }
+
+  num_workers = workers;
+  wheel_now = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+  return 0;
+}
+
+int scheduler_spawn(task_fn fn, void *arg) {
+  struct Task *task = malloc(sizeof(struct Task));
+  if (task == NULL) {
+    fprintf(stderr, "Error allocating memory for task\n");
+    return 1;
+  }
+
+  task->fn = fn;
+  task->arg = arg;
+
+  pthread_mutex_lock(&scheduler_lock);
+  push_ready(task);
+  num_tasks++;
+  pthread_mutex_unlock(&scheduler_lock);
+
+  return 0;
+}
+
+int scheduler_run(void) {
+  pthread_t timer_thread;
+  pthread_t *worker_threads = malloc(num_workers * sizeof(pthread_t));
+
+  if (worker_threads == NULL) {
+    fprintf(stderr, "Error allocating memory for workers\n");
+    return 1;
+  }
+
+  if (pthread_create(&timer_thread, NULL, timer_main, NULL) != 0) {
+    fprintf(stderr, "Failed to create timer thread\n");
+    free(worker_threads);
+    return 1;
+  }
+
+  unsigned int started = 0;
+  for (; started < num_workers; started++) {
+    if (pthread_create(&worker_threads[started], NULL, worker_main, NULL) != 0) {
+      fprintf(stderr, "Failed to create worker thread\n");
+      break;
+    }
+  }
+
+  // Run the tasks on the calling thread if no worker could be started.
+  if (started == 0) {
+    worker_main(NULL);
+  }
+
+  for (unsigned int i = 0; i < started; i++) {
+    pthread_join(worker_threads[i], NULL);
+  }
+  pthread_join(timer_thread, NULL);
+
+  free(worker_threads);
+  return 0;
+}
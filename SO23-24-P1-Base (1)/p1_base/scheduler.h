@@ -0,0 +1,28 @@
+#ifndef EMS_SCHEDULER_H
+#define EMS_SCHEDULER_H
+
+/// Value returned by a task step once the task has finished.
+#define TASK_DONE (-1L)
+
+/// Runs one step of a cooperative task.
+/// @param arg Argument given to scheduler_spawn.
+/// @return Milliseconds to suspend the task for before its next step, TASK_DONE once it has finished.
+typedef long (*task_fn)(void *arg);
+
+/// Initializes the scheduler.
+/// @param num_workers Number of worker threads that run task steps.
+/// @return 0 if the scheduler was initialized successfully, 1 otherwise.
+int scheduler_init(unsigned int num_workers);
+
+/// Adds a task to the scheduler. Tasks start running on scheduler_run.
+/// @param fn Function that runs one step of the task.
+/// @param arg Argument passed to every step.
+/// @return 0 if the task was added successfully, 1 otherwise.
+int scheduler_spawn(task_fn fn, void *arg);
+
+/// Runs every task to completion on the worker threads.
+/// Suspended tasks wait on a timer wheel and do not hold a worker.
+/// @return 0 if all tasks ran successfully, 1 otherwise.
+int scheduler_run(void);
+
+#endif  // EMS_SCHEDULER_H
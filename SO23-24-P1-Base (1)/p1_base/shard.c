@@ -0,0 +1,399 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np on Linux
+#include "shard.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "constants.h"
+#include "operations.h"
+#include "parser.h"
+
+#define SHARD_QUEUE_SIZE 64
+#define CACHE_LINE_SIZE 64
+
+struct ShardRequest {
+  enum Command cmd;
+  unsigned int event_id;
+  unsigned int reservation_id;
+  unsigned long seq;  /// Creation order of the event, for CREATE.
+  size_t num_rows;
+  size_t num_cols;
+  size_t num_seats;
+  size_t xs[MAX_RESERVATION_SIZE];
+  size_t ys[MAX_RESERVATION_SIZE];
+  int out_fd;
+  int rle;  /// Whether SHOW prints the event run-length encoded.
+  int result;  /// Result of the command, valid once the request has completed.
+};
+
+struct ShardEvent {
+  unsigned long seq;
+  unsigned int id;
+};
+
+struct Shard {
+  struct ShardRequest requests[SHARD_QUEUE_SIZE];
+
+  // Each counter has its own cache line, as the producer and the shard write them concurrently.
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t head;  /// Number of requests submitted, written by the producer.
+  _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;  /// Number of requests completed, written by the shard.
+  _Alignas(CACHE_LINE_SIZE) atomic_int state;    /// 0 while starting, 1 once running, -1 if it failed to start.
+
+  pthread_t thread;
+  unsigned int index;
+  const struct ems_options *options;  /// Settings of the instance, only read while the shard starts.
+  struct ems_instance *ems;           /// Private EMS instance with the events owned by the shard.
+
+  struct ShardEvent *created;  /// Events created by the shard, in creation order.
+  size_t num_created;
+  size_t created_capacity;
+};
+
+static struct Shard *shards = NULL;
+static unsigned int num_shards = 0;
+static unsigned long next_seq = 0;
+
+static void backoff(unsigned int *spins) {
+  (*spins)++;
+
+  if (*spins < 64) {
+    return;
+  }
+
+  if (*spins < 128) {
+    sched_yield();
+    return;
+  }
+
+  struct timespec pause = {0, 50000};
+  nanosleep(&pause, NULL);
+}
+
+/// Fibonacci hashing: the product spreads consecutive ids over the 32 bits, and its high bits are
+/// scaled to the number of shards, so the low bits of the id alone never pick the shard.
+static struct Shard *owner(unsigned int event_id) {
+  uint32_t hash = (uint32_t)event_id * 2654435761u;
+  return &shards[(uint64_t)hash * num_shards >> 32];
+}
+
+static struct ShardRequest *next_request(struct Shard *shard) {
+  size_t head = atomic_load_explicit(&shard->head, memory_order_relaxed);
+
+  unsigned int spins = 0;
+  while (head - atomic_load_explicit(&shard->tail, memory_order_acquire) == SHARD_QUEUE_SIZE) {
+    backoff(&spins);
+  }
+
+  return &shard->requests[head % SHARD_QUEUE_SIZE];
+}
+
+/// Hands the request returned by next_request over to the shard.
+/// @return Ticket to wait for the request with.
+static size_t submit(struct Shard *shard) {
+  size_t head = atomic_load_explicit(&shard->head, memory_order_relaxed);
+  atomic_store_explicit(&shard->head, head + 1, memory_order_release);
+  return head;
+}
+
+static void wait_for(struct Shard *shard, size_t ticket) {
+  unsigned int spins = 0;
+  while (atomic_load_explicit(&shard->tail, memory_order_acquire) <= ticket) {
+    backoff(&spins);
+  }
+}
+
+static void record_created(struct Shard *shard, unsigned long seq, unsigned int event_id) {
+  if (shard->num_created == shard->created_capacity) {
+    size_t capacity = shard->created_capacity ? shard->created_capacity * 2 : 16;
+    struct ShardEvent *created = realloc(shard->created, capacity * sizeof(struct ShardEvent));
+
+    if (created == NULL) {
+      fprintf(stderr, "Error allocating memory for shard event log\n");
+      return;
+    }
+
+    shard->created = created;
+    shard->created_capacity = capacity;
+  }
+
+  shard->created[shard->num_created++] = (struct ShardEvent){seq, event_id};
+}
+
+static void execute(struct Shard *shard, struct ShardRequest *request) {
+  switch (request->cmd) {
+    case CMD_CREATE:
+      request->result = ems_create(shard->ems, request->event_id, request->num_rows, request->num_cols);
+      if (request->result) {
+        fprintf(stderr, "Failed to create event\n");
+      } else {
+        record_created(shard, request->seq, request->event_id);
+      }
+      break;
+
+    case CMD_RESERVE:
+      request->result = ems_reserve(shard->ems, request->event_id, request->num_seats, request->xs, request->ys);
+      if (request->result) {
+        fprintf(stderr, "Failed to reserve seats\n");
+      }
+      break;
+
+    case CMD_CANCEL:
+      request->result = ems_cancel(shard->ems, request->event_id, request->reservation_id);
+      if (request->result) {
+        fprintf(stderr, "Failed to cancel reservation\n");
+      }
+      break;
+
+    case CMD_SHOW: {
+      struct ems_output out = {ems_write_fd, &request->out_fd, request->rle};
+      request->result = ems_show(shard->ems, request->event_id, &out);
+      break;
+    }
+
+    case CMD_LIST_EVENTS:  // Only drains the queue, the producer reads the event log afterwards.
+    case CMD_FORMAT:
+    case CMD_BEGIN:
+    case CMD_COMMIT:
+    case CMD_WAIT:
+    case CMD_BARRIER:
+    case CMD_HELP:
+    case CMD_EMPTY:
+    case CMD_INVALID:
+    case EOC:
+      request->result = 0;
+      break;
+  }
+}
+
+static void *shard_main(void *arg) {
+  struct Shard *shard = arg;
+
+  // Shards are only pinned to a CPU where the system lets threads choose one.
+#ifdef __linux__
+  long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (num_cpus > 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(shard->index % (unsigned long)num_cpus, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#endif
+
+  shard->ems = ems_init(shard->options);
+  if (shard->ems == NULL) {
+    atomic_store_explicit(&shard->state, -1, memory_order_release);
+    return NULL;
+  }
+  atomic_store_explicit(&shard->state, 1, memory_order_release);
+
+  size_t tail = 0;
+  while (1) {
+    unsigned int spins = 0;
+    while (atomic_load_explicit(&shard->head, memory_order_acquire) == tail) {
+      backoff(&spins);
+    }
+
+    struct ShardRequest *request = &shard->requests[tail % SHARD_QUEUE_SIZE];
+    int stop = request->cmd == EOC;
+
+    execute(shard, request);
+    atomic_store_explicit(&shard->tail, ++tail, memory_order_release);
+
+    if (stop) {
+      break;
+    }
+  }
+
+  ems_terminate(shard->ems);
+  return NULL;
+}
+
+int shards_init(unsigned int count, const struct ems_options *options) {
+  if (count == 0) {
+    fprintf(stderr, "At least one shard is needed\n");
+    return 1;
+  }
+
+  shards = aligned_alloc(CACHE_LINE_SIZE, count * sizeof(struct Shard));
+  if (shards == NULL) {
+    fprintf(stderr, "Error allocating memory for shards\n");
+    return 1;
+  }
+
+  int ret = 0;
+  for (num_shards = 0; num_shards < count; num_shards++) {
+    struct Shard *shard = &shards[num_shards];
+    atomic_init(&shard->head, 0);
+    atomic_init(&shard->tail, 0);
+    atomic_init(&shard->state, 0);
+    shard->index = num_shards;
+    shard->options = options;
+    shard->created = NULL;
+    shard->num_created = 0;
+    shard->created_capacity = 0;
+
+    if (pthread_create(&shard->thread, NULL, shard_main, shard) != 0) {
+      fprintf(stderr, "Failed to create shard thread\n");
+      ret = 1;
+      break;
+    }
+
+    unsigned int spins = 0;
+    while (atomic_load_explicit(&shard->state, memory_order_acquire) == 0) {
+      backoff(&spins);
+    }
+
+    if (atomic_load_explicit(&shard->state, memory_order_relaxed) < 0) {
+      fprintf(stderr, "Failed to initialize shard state\n");
+      pthread_join(shard->thread, NULL);
+      ret = 1;
+      break;
+    }
+  }
+
+  if (ret) {
+    shards_terminate();
+  }
+
+  return ret;
+}
+
+void shards_terminate() {
+  for (unsigned int i = 0; i < num_shards; i++) {
+    next_request(&shards[i])->cmd = EOC;
+    submit(&shards[i]);
+  }
+
+  for (unsigned int i = 0; i < num_shards; i++) {
+    pthread_join(shards[i].thread, NULL);
+    free(shards[i].created);
+  }
+
+  free(shards);
+  shards = NULL;
+  num_shards = 0;
+}
+
+int shard_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  struct Shard *shard = owner(event_id);
+  struct ShardRequest *request = next_request(shard);
+
+  request->cmd = CMD_CREATE;
+  request->event_id = event_id;
+  request->num_rows = num_rows;
+  request->num_cols = num_cols;
+  request->seq = next_seq++;
+
+  submit(shard);
+  return 0;
+}
+
+int shard_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "Too many seats\n");
+    return 1;
+  }
+
+  struct Shard *shard = owner(event_id);
+  struct ShardRequest *request = next_request(shard);
+
+  request->cmd = CMD_RESERVE;
+  request->event_id = event_id;
+  request->num_seats = num_seats;
+  for (size_t i = 0; i < num_seats; i++) {
+    request->xs[i] = xs[i];
+    request->ys[i] = ys[i];
+  }
+
+  submit(shard);
+  return 0;
+}
+
+int shard_cancel(unsigned int event_id, unsigned int reservation_id) {
+  struct Shard *shard = owner(event_id);
+  struct ShardRequest *request = next_request(shard);
+
+  request->cmd = CMD_CANCEL;
+  request->event_id = event_id;
+  request->reservation_id = reservation_id;
+
+  submit(shard);
+  return 0;
+}
+
+int shard_show(unsigned int event_id, int out_fd, int rle) {
+  struct Shard *shard = owner(event_id);
+  struct ShardRequest *request = next_request(shard);
+
+  request->cmd = CMD_SHOW;
+  request->event_id = event_id;
+  request->out_fd = out_fd;
+  request->rle = rle;
+
+  wait_for(shard, submit(shard));
+  return request->result;
+}
+
+int shard_list_events(int out_fd) {
+  size_t *tickets = malloc(num_shards * sizeof(size_t));
+  size_t *positions = calloc(num_shards, sizeof(size_t));
+
+  if (tickets == NULL || positions == NULL) {
+    fprintf(stderr, "Error allocating memory for event listing\n");
+    free(tickets);
+    free(positions);
+    return 1;
+  }
+
+  // Scatter: once a shard has run every command before the LIST, its event log is complete.
+  for (unsigned int i = 0; i < num_shards; i++) {
+    next_request(&shards[i])->cmd = CMD_LIST_EVENTS;
+    tickets[i] = submit(&shards[i]);
+  }
+
+  for (unsigned int i = 0; i < num_shards; i++) {
+    wait_for(&shards[i], tickets[i]);
+  }
+
+  // Gather: merge the logs of the shards by creation order.
+  struct ems_output out = {ems_write_fd, &out_fd, 0};
+  size_t listed = 0;
+  int ret = 0;
+  while (ret == 0) {
+    struct Shard *next = NULL;
+    unsigned int next_index = 0;
+
+    for (unsigned int i = 0; i < num_shards; i++) {
+      struct Shard *shard = &shards[i];
+      if (positions[i] < shard->num_created &&
+          (next == NULL || shard->created[positions[i]].seq < next->created[positions[next_index]].seq)) {
+        next = shard;
+        next_index = i;
+      }
+    }
+
+    if (next == NULL) {
+      break;
+    }
+
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "Event: %u\n", next->created[positions[next_index]++].id);
+    ret = out.write(out.context, buffer, (size_t)length);
+    listed++;
+  }
+
+  if (listed == 0) {
+    ret = out.write(out.context, "No events\n", strlen("No events\n"));
+  }
+
+  free(tickets);
+  free(positions);
+  return ret;
+}
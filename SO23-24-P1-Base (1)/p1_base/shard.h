@@ -0,0 +1,54 @@
+#ifndef EMS_SHARD_H
+#define EMS_SHARD_H
+
+#include <stddef.h>
+
+// Shared-nothing execution: events are partitioned by a hash of their id across shards, each owned
+// by one pinned thread with a private EMS instance. Commands are routed to the owning shard through
+// single-producer single-consumer queues, so all shard functions must be called from one thread.
+
+struct ems_options;
+
+/// Starts the shard threads, each with its own EMS instance.
+/// @param num_shards Number of shards.
+/// @param options Settings of the instances of the shards.
+/// @return 0 if the shards were started successfully, 1 otherwise.
+int shards_init(unsigned int num_shards, const struct ems_options *options);
+
+/// Stops the shard threads after they have run every pending command, and destroys their state.
+void shards_terminate();
+
+/// Submits a CREATE to the owning shard without waiting for it to run.
+/// @param event_id Id of the event to be created.
+/// @param num_rows Number of rows of the event to be created.
+/// @param num_cols Number of columns of the event to be created.
+/// @return 0 if the command was submitted successfully, 1 otherwise.
+int shard_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Submits a RESERVE to the owning shard without waiting for it to run.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Array of rows of the seats to reserve.
+/// @param ys Array of columns of the seats to reserve.
+/// @return 0 if the command was submitted successfully, 1 otherwise.
+int shard_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+
+/// Submits a CANCEL to the owning shard without waiting for it to run.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the command was submitted successfully, 1 otherwise.
+int shard_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Runs a SHOW on the owning shard and waits for it, so that the output keeps its order.
+/// @param event_id Id of the event to print.
+/// @param out_fd File descriptor to print the event to.
+/// @param rle Whether to print the event run-length encoded.
+/// @return 0 if the event was printed successfully, 1 otherwise.
+int shard_show(unsigned int event_id, int out_fd, int rle);
+
+/// Gathers the events of every shard and prints them in creation order.
+/// @param out_fd File descriptor to print the events to.
+/// @return 0 if the events were printed successfully, 1 otherwise.
+int shard_list_events(int out_fd);
+
+#endif  // EMS_SHARD_H
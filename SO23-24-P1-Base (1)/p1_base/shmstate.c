@@ -0,0 +1,807 @@
+#include "shmstate.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "operations.h"
+#include "reservation.h"
+#include "rle.h"
+
+#define SHARED_ALIGN 16
+#define MIN_SIZE_CLASS 5  // 32 byte blocks, the smallest that fit a block header and a payload.
+#define NUM_SIZE_CLASSES 48
+
+// Offset from the start of the segment. The header is at offset 0, so 0 is used as NULL.
+typedef size_t shm_off;
+
+struct SharedBlock {
+  size_t size_class;  /// The block holds 2^size_class bytes, this header included.
+  shm_off next_free;  /// Next free block of the same class, while the block is free.
+};
+
+/// Arrays and sizes an event switches to once its reservations are compacted.
+struct SharedCompaction {
+  shm_off index;
+  size_t index_capacity;
+  unsigned int index_base;
+  shm_off arena;
+  size_t arena_size;
+  size_t arena_capacity;
+};
+
+struct SharedEvent {
+  unsigned int id;            /// Event id
+  _Atomic unsigned int reservations;  /// Number of committed reservations for the event.
+
+  size_t cols;  /// Number of columns.
+  size_t rows;  /// Number of rows.
+
+  shm_off seats;          /// Array of size rows * cols with the reservations for each seat.
+  shm_off index;             /// Array indexed by reservation id - index_base - 1 with the seats of each reservation.
+  size_t index_capacity;     /// Number of entries allocated for the index.
+  unsigned int index_base;   /// Number of reservations dropped from the front of the index.
+  shm_off arena;             /// Seat indices of every reservation, stored contiguously.
+  atomic_size_t arena_size;  /// Number of seat indices in use in the arena.
+  size_t arena_capacity;     /// Number of seat indices allocated for the arena.
+  size_t live_seats;         /// Number of seat indices in the arena held by reservations not cancelled.
+
+  // Command in progress, used to repair the event when its process dies holding the mutex. A process
+  // may be killed between any two instructions, so the steps of a command must reach memory in
+  // program order: the fields that repair_event reads are written with release stores, which keep
+  // every earlier store ahead of them, and a signal fence keeps the seats written after the store
+  // that records them.
+  _Atomic unsigned int pending_reservation;  /// Id of the reservation being written, 0 if none.
+  atomic_size_t pending_seats;               /// Number of seats of the pending reservation written to the arena.
+  _Atomic unsigned int pending_cancel;       /// Id of the reservation being cancelled, 0 if none.
+  _Atomic int compacting;                    /// Whether the event is switching to the compacted arrays.
+  struct SharedCompaction compaction;        /// Compacted arrays, while compacting is set.
+
+  pthread_mutex_t mutex;  /// Protects the seats and reservations of the event.
+  _Atomic shm_off next;   /// Next event in creation order.
+};
+
+struct SharedHeader {
+  size_t size;            /// Size of the segment.
+  unsigned int delay_ms;  /// State access delay.
+
+  pthread_mutex_t alloc_lock;            /// Protects the free lists.
+  atomic_size_t top;                     /// Start of the space that was never allocated.
+  shm_off free_lists[NUM_SIZE_CLASSES];  /// Free blocks of each size class.
+
+  // Events are only ever appended and their links are atomic, so readers walk them without locks.
+  pthread_mutex_t list_lock;  /// Serializes the creation of events.
+  _Atomic shm_off head;
+  shm_off tail;
+};
+
+static char *base = NULL;
+static size_t mapped_size = 0;
+
+static void *at(shm_off offset) {
+  return offset ? base + offset : NULL;
+}
+
+static struct SharedHeader *header() {
+  return (struct SharedHeader *)base;
+}
+
+static void access_delay() {
+  if (header()->delay_ms == 0) {
+    return;
+  }
+
+  ems_wait(header()->delay_ms);
+}
+
+// Robust mutexes are only available on Linux. Elsewhere the mutexes are only process-shared, and a
+// lock held by a process that dies is never released, so EOWNERDEAD is never returned.
+static int init_robust_mutex(pthread_mutex_t *mutex) {
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0) {
+    return 1;
+  }
+
+  int ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0;
+#ifdef __linux__
+  ret = ret || pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) != 0;
+#endif
+  ret = ret || pthread_mutex_init(mutex, &attr) != 0;
+
+  pthread_mutexattr_destroy(&attr);
+  return ret;
+}
+
+/// Marks a robust mutex whose owner died as consistent again, once what it protects is repaired.
+static void make_consistent(pthread_mutex_t *mutex) {
+#ifdef __linux__
+  pthread_mutex_consistent(mutex);
+#else
+  (void)mutex;
+#endif
+}
+
+static int lock_allocator() {
+  struct SharedHeader *shared = header();
+
+  int ret = pthread_mutex_lock(&shared->alloc_lock);
+  if (ret == EOWNERDEAD) {
+    // The free lists may have been left half updated, so they are dropped and their blocks leaked.
+    memset(shared->free_lists, 0, sizeof(shared->free_lists));
+    make_consistent(&shared->alloc_lock);
+    ret = 0;
+  }
+
+  return ret != 0;
+}
+
+/// Allocates a block in the segment, reusing a freed one of the same size class if there is one.
+/// @param size Number of bytes to allocate.
+/// @param recycled Set to whether the block was freed before, otherwise it was never touched.
+/// @return Offset of the allocated memory, 0 if the segment is full.
+static shm_off alloc_block(size_t size, int *recycled) {
+  struct SharedHeader *shared = header();
+
+  size_t size_class = MIN_SIZE_CLASS;
+  while (size_class < NUM_SIZE_CLASSES && ((size_t)1 << size_class) - sizeof(struct SharedBlock) < size) {
+    size_class++;
+  }
+
+  if (size_class == NUM_SIZE_CLASSES) {
+    return 0;
+  }
+
+  shm_off block = 0;
+  *recycled = 0;
+  if (lock_allocator() == 0) {
+    block = shared->free_lists[size_class];
+    if (block != 0) {
+      shared->free_lists[size_class] = ((struct SharedBlock *)at(block))->next_free;
+      *recycled = 1;
+    }
+    pthread_mutex_unlock(&shared->alloc_lock);
+  }
+
+  if (block == 0) {
+    size_t block_size = (size_t)1 << size_class;
+    size_t top = atomic_load(&shared->top);
+
+    do {
+      if (block_size > shared->size - top) {
+        return 0;
+      }
+    } while (!atomic_compare_exchange_weak(&shared->top, &top, top + block_size));
+
+    block = top;
+  }
+
+  ((struct SharedBlock *)at(block))->size_class = size_class;
+  return block + sizeof(struct SharedBlock);
+}
+
+/// Allocates memory in the segment.
+/// @param size Number of bytes to allocate.
+/// @return Offset of the allocated memory, 0 if the segment is full.
+static shm_off shared_alloc(size_t size) {
+  int recycled;
+  return alloc_block(size, &recycled);
+}
+
+/// Allocates zeroed memory in the segment. The segment starts out as demand-zero pages, so only
+/// recycled blocks are cleared and the pages of a fresh block are committed when first written.
+/// @param size Number of bytes to allocate.
+/// @return Offset of the allocated memory, 0 if the segment is full.
+static shm_off shared_calloc(size_t size) {
+  int recycled;
+  shm_off offset = alloc_block(size, &recycled);
+
+  if (offset != 0 && recycled) {
+    memset(at(offset), 0, size);
+  }
+
+  return offset;
+}
+
+static void shared_free(shm_off offset) {
+  if (offset == 0) {
+    return;
+  }
+
+  struct SharedHeader *shared = header();
+  shm_off block = offset - sizeof(struct SharedBlock);
+  struct SharedBlock *free_block = at(block);
+
+  // Without the lock the block cannot be linked safely, so it is leaked.
+  if (lock_allocator() != 0) {
+    return;
+  }
+
+  free_block->next_free = shared->free_lists[free_block->size_class];
+  shared->free_lists[free_block->size_class] = block;
+
+  pthread_mutex_unlock(&shared->alloc_lock);
+}
+
+/// Makes an array in the segment hold at least the given number of elements.
+static int grow_array(shm_off *array, size_t *capacity, size_t needed, size_t initial, size_t element_size) {
+  if (needed <= *capacity) {
+    return 0;
+  }
+
+  size_t new_capacity = *capacity ? *capacity * 2 : initial;
+  while (new_capacity < needed) {
+    new_capacity *= 2;
+  }
+
+  shm_off grown = shared_alloc(new_capacity * element_size);
+  if (grown == 0) {
+    return 1;
+  }
+
+  if (*array != 0) {
+    memcpy(at(grown), at(*array), *capacity * element_size);
+  }
+
+  // The array is replaced before its capacity grows, so a repair never reads past its end.
+  shm_off old = *array;
+  *array = grown;
+  *capacity = new_capacity;
+  shared_free(old);
+
+  return 0;
+}
+
+static int lock_list() {
+  struct SharedHeader *shared = header();
+
+  int ret = pthread_mutex_lock(&shared->list_lock);
+  if (ret == EOWNERDEAD) {
+    // An event may have been linked without the tail moving to it, so the tail is looked up again.
+    shared->tail = 0;
+    for (shm_off offset = atomic_load(&shared->head); offset != 0;
+         offset = atomic_load(&((struct SharedEvent *)at(offset))->next)) {
+      shared->tail = offset;
+    }
+
+    make_consistent(&shared->list_lock);
+    ret = 0;
+  }
+
+  return ret != 0;
+}
+
+/// Makes an event use its compacted arrays.
+static void apply_compaction(struct SharedEvent *event) {
+  struct SharedCompaction *compaction = &event->compaction;
+  event->index = compaction->index;
+  event->index_capacity = compaction->index_capacity;
+  event->index_base = compaction->index_base;
+  event->arena = compaction->arena;
+  event->arena_capacity = compaction->arena_capacity;
+  atomic_store_explicit(&event->arena_size, compaction->arena_size, memory_order_relaxed);
+}
+
+/// Finishes or undoes the command that a terminated process left half done on an event.
+static void repair_event(struct SharedEvent *event) {
+  if (event->compacting) {
+    // The old arrays may have been freed already, so they are leaked rather than freed twice.
+    apply_compaction(event);
+    event->compacting = 0;
+  }
+
+  unsigned int *seats = at(event->seats);
+  size_t *arena = at(event->arena);
+  struct Reservation *index = at(event->index);
+
+  if (event->pending_reservation != 0) {
+    if (event->pending_reservation > event->reservations) {
+      // Not committed: the seats written so far are freed.
+      for (size_t i = 0; i < event->pending_seats; i++) {
+        size_t seat = arena[event->arena_size + i];
+        if (seats[seat] == event->pending_reservation) {
+          seats[seat] = 0;
+        }
+      }
+    } else {
+      // Committed: only the arena may be missing the seats of the reservation.
+      struct Reservation *reservation = &index[event->pending_reservation - event->index_base - 1];
+      event->arena_size = reservation->offset + reservation->num_seats;
+    }
+
+    event->pending_reservation = 0;
+    event->pending_seats = 0;
+  }
+
+  if (event->pending_cancel != 0) {
+    // Cancelling twice frees the same seats, so the cancellation is completed.
+    struct Reservation *reservation = &index[event->pending_cancel - event->index_base - 1];
+    for (size_t i = 0; i < reservation->num_seats; i++) {
+      size_t seat = arena[reservation->offset + i];
+      if (seats[seat] == event->pending_cancel) {
+        seats[seat] = 0;
+      }
+    }
+
+    reservation->num_seats = 0;
+    event->pending_cancel = 0;
+  }
+
+  // The count may have missed the last command, so it is taken again.
+  event->live_seats = 0;
+  for (unsigned int i = 0; i < event->reservations - event->index_base; i++) {
+    event->live_seats += index[i].num_seats;
+  }
+}
+
+static int lock_event(struct SharedEvent *event) {
+  int ret = pthread_mutex_lock(&event->mutex);
+  if (ret == EOWNERDEAD) {
+    fprintf(stderr, "Repairing event %u after its process terminated\n", event->id);
+    repair_event(event);
+    make_consistent(&event->mutex);
+    ret = 0;
+  }
+
+  if (ret != 0) {
+    fprintf(stderr, "Failed to lock event\n");
+  }
+
+  return ret != 0;
+}
+
+static struct SharedEvent *find_event(unsigned int event_id) {
+  shm_off offset = atomic_load_explicit(&header()->head, memory_order_acquire);
+
+  while (offset != 0) {
+    struct SharedEvent *event = at(offset);
+    if (event->id == event_id) {
+      return event;
+    }
+    offset = atomic_load_explicit(&event->next, memory_order_acquire);
+  }
+
+  return NULL;
+}
+
+static struct SharedEvent *get_event_with_delay(unsigned int event_id) {
+  access_delay();
+  return find_event(event_id);
+}
+
+int shared_init(unsigned int delay_ms, size_t size) {
+  if (base != NULL) {
+    fprintf(stderr, "Shared state has already been initialized\n");
+    return 1;
+  }
+
+  if (size < sizeof(struct SharedHeader) + SHARED_ALIGN) {
+    fprintf(stderr, "Shared state is too small\n");
+    return 1;
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/ems-%ld", (long)getpid());
+
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+  if (fd == -1) {
+    fprintf(stderr, "Failed to create shared memory segment\n");
+    return 1;
+  }
+
+  // The worker processes inherit the mapping, so the name is not needed past this point.
+  shm_unlink(name);
+
+  if (ftruncate(fd, (off_t)size) != 0) {
+    fprintf(stderr, "Failed to size shared memory segment\n");
+    close(fd);
+    return 1;
+  }
+
+  void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "Failed to map shared memory segment\n");
+    return 1;
+  }
+
+  base = mapping;
+  mapped_size = size;
+
+  // The segment starts out zeroed, so the free lists and the event list are already empty.
+  struct SharedHeader *shared = header();
+  shared->size = size;
+  shared->delay_ms = delay_ms;
+  atomic_init(&shared->top, (sizeof(struct SharedHeader) + SHARED_ALIGN - 1) / SHARED_ALIGN * SHARED_ALIGN);
+
+  if (init_robust_mutex(&shared->alloc_lock) != 0 || init_robust_mutex(&shared->list_lock) != 0) {
+    fprintf(stderr, "Failed to initialize shared state locks\n");
+    munmap(base, mapped_size);
+    base = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+void shared_terminate() {
+  if (base == NULL) {
+    return;
+  }
+
+  struct SharedHeader *shared = header();
+
+  shm_off offset = atomic_load(&shared->head);
+  while (offset != 0) {
+    struct SharedEvent *event = at(offset);
+    pthread_mutex_destroy(&event->mutex);
+    offset = atomic_load(&event->next);
+  }
+
+  pthread_mutex_destroy(&shared->list_lock);
+  pthread_mutex_destroy(&shared->alloc_lock);
+
+  munmap(base, mapped_size);
+  base = NULL;
+  mapped_size = 0;
+}
+
+int shared_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (base == NULL) {
+    fprintf(stderr, "Shared state must be initialized\n");
+    return 1;
+  }
+
+  if (get_event_with_delay(event_id) != NULL) {
+    fprintf(stderr, "Event already exists\n");
+    return 1;
+  }
+
+  shm_off offset = shared_alloc(sizeof(struct SharedEvent));
+  shm_off seats = shared_calloc(num_rows * num_cols * sizeof(unsigned int));
+
+  if (offset == 0 || seats == 0) {
+    fprintf(stderr, "Error allocating shared memory for event\n");
+    shared_free(offset);
+    shared_free(seats);
+    return 1;
+  }
+
+  struct SharedEvent *event = at(offset);
+  memset(event, 0, sizeof(struct SharedEvent));
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->seats = seats;
+
+  if (init_robust_mutex(&event->mutex) != 0) {
+    fprintf(stderr, "Failed to initialize event lock\n");
+    shared_free(seats);
+    shared_free(offset);
+    return 1;
+  }
+
+  if (lock_list() != 0) {
+    fprintf(stderr, "Failed to lock event list\n");
+    pthread_mutex_destroy(&event->mutex);
+    shared_free(seats);
+    shared_free(offset);
+    return 1;
+  }
+
+  struct SharedHeader *shared = header();
+
+  // Another process may have created the same event since the first lookup.
+  if (find_event(event_id) != NULL) {
+    pthread_mutex_unlock(&shared->list_lock);
+    fprintf(stderr, "Event already exists\n");
+    pthread_mutex_destroy(&event->mutex);
+    shared_free(seats);
+    shared_free(offset);
+    return 1;
+  }
+
+  if (shared->tail == 0) {
+    atomic_store_explicit(&shared->head, offset, memory_order_release);
+  } else {
+    atomic_store_explicit(&((struct SharedEvent *)at(shared->tail))->next, offset, memory_order_release);
+  }
+  shared->tail = offset;
+
+  pthread_mutex_unlock(&shared->list_lock);
+
+  return 0;
+}
+
+int shared_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys) {
+  if (base == NULL) {
+    fprintf(stderr, "Shared state must be initialized\n");
+    return 1;
+  }
+
+  struct SharedEvent *event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    return 1;
+  }
+
+  unsigned int reservation_id = event->reservations + 1;
+
+  if (grow_array(&event->index, &event->index_capacity, reservation_id - event->index_base, 16,
+                 sizeof(struct Reservation)) != 0 ||
+      grow_array(&event->arena, &event->arena_capacity, event->arena_size + num_seats, 64, sizeof(size_t)) != 0) {
+    pthread_mutex_unlock(&event->mutex);
+    fprintf(stderr, "Error allocating shared memory for reservation\n");
+    return 1;
+  }
+
+  unsigned int *seats = at(event->seats);
+  size_t *reserved = (size_t *)at(event->arena) + event->arena_size;
+
+  atomic_store_explicit(&event->pending_seats, 0, memory_order_release);
+  atomic_store_explicit(&event->pending_reservation, reservation_id, memory_order_release);
+
+  size_t i = 0;
+  for (; i < num_seats; i++) {
+    size_t row = xs[i];
+    size_t col = ys[i];
+
+    if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
+      fprintf(stderr, "Invalid seat\n");
+      break;
+    }
+
+    size_t seat = (row - 1) * event->cols + col - 1;
+
+    access_delay();
+    if (seats[seat] != 0) {
+      fprintf(stderr, "Seat already reserved\n");
+      break;
+    }
+
+    // The seat is recorded before it is written, so that a repair can find it.
+    reserved[i] = seat;
+    atomic_store_explicit(&event->pending_seats, i + 1, memory_order_release);
+    atomic_signal_fence(memory_order_seq_cst);
+
+    access_delay();
+    seats[seat] = reservation_id;
+  }
+
+  if (i < num_seats) {
+    for (size_t j = 0; j < i; j++) {
+      access_delay();
+      seats[reserved[j]] = 0;
+    }
+
+    atomic_store_explicit(&event->pending_reservation, 0, memory_order_release);
+    atomic_store_explicit(&event->pending_seats, 0, memory_order_release);
+    pthread_mutex_unlock(&event->mutex);
+    return 1;
+  }
+
+  struct Reservation *index = at(event->index);
+  size_t arena_size = atomic_load_explicit(&event->arena_size, memory_order_relaxed);
+  index[reservation_id - event->index_base - 1] = (struct Reservation){arena_size, num_seats};
+
+  // The reservation is committed once it is counted, and only then are its seats added to the arena.
+  atomic_store_explicit(&event->reservations, reservation_id, memory_order_release);
+  atomic_store_explicit(&event->arena_size, arena_size + num_seats, memory_order_release);
+  event->live_seats += num_seats;
+
+  atomic_store_explicit(&event->pending_reservation, 0, memory_order_release);
+  atomic_store_explicit(&event->pending_seats, 0, memory_order_release);
+  pthread_mutex_unlock(&event->mutex);
+
+  return 0;
+}
+
+/// Compacts the index and the arena of an event into smaller arrays. The old arrays are left as
+/// they are until the event switches to the new ones, so a repair can always finish the switch.
+static void compact_event(struct SharedEvent *event) {
+  size_t num_entries = event->reservations - event->index_base;
+  struct SharedCompaction *compaction = &event->compaction;
+
+  // Compacting is only an optimization, so it is given up if the segment is full.
+  compaction->index_capacity = shrunk_capacity(event->index_capacity, num_entries, 16);
+  compaction->arena_capacity = shrunk_capacity(event->arena_capacity, event->live_seats, 64);
+  compaction->index = shared_alloc(compaction->index_capacity * sizeof(struct Reservation));
+  compaction->arena = shared_alloc(compaction->arena_capacity * sizeof(size_t));
+
+  if (compaction->index == 0 || compaction->arena == 0) {
+    shared_free(compaction->index);
+    shared_free(compaction->arena);
+    return;
+  }
+
+  compaction->arena_size = pack_reservations(at(event->index), num_entries, at(event->arena), at(compaction->index),
+                                             at(compaction->arena), &num_entries);
+  compaction->index_base = event->reservations - (unsigned int)num_entries;
+
+  shm_off old_index = event->index;
+  shm_off old_arena = event->arena;
+
+  atomic_store_explicit(&event->compacting, 1, memory_order_release);
+  atomic_signal_fence(memory_order_seq_cst);
+
+  apply_compaction(event);
+  shared_free(old_index);
+  shared_free(old_arena);
+
+  atomic_store_explicit(&event->compacting, 0, memory_order_release);
+}
+
+int shared_cancel(unsigned int event_id, unsigned int reservation_id) {
+  if (base == NULL) {
+    fprintf(stderr, "Shared state must be initialized\n");
+    return 1;
+  }
+
+  struct SharedEvent *event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    return 1;
+  }
+
+  struct Reservation *reservation = NULL;
+  if (reservation_id > event->index_base && reservation_id <= event->reservations) {
+    reservation = &((struct Reservation *)at(event->index))[reservation_id - event->index_base - 1];
+  }
+
+  if (reservation == NULL || reservation->num_seats == 0) {
+    pthread_mutex_unlock(&event->mutex);
+    fprintf(stderr, "Reservation not found\n");
+    return 1;
+  }
+
+  unsigned int *seats = at(event->seats);
+  size_t *reserved = (size_t *)at(event->arena) + reservation->offset;
+
+  atomic_store_explicit(&event->pending_cancel, reservation_id, memory_order_release);
+  atomic_signal_fence(memory_order_seq_cst);
+
+  for (size_t i = 0; i < reservation->num_seats; i++) {
+    access_delay();
+    seats[reserved[i]] = 0;
+  }
+
+  event->live_seats -= reservation->num_seats;
+  reservation->num_seats = 0;
+  atomic_store_explicit(&event->pending_cancel, 0, memory_order_release);
+
+  if (should_compact_reservations(event->arena_size, event->live_seats, event->reservations - event->index_base)) {
+    compact_event(event);
+  }
+
+  pthread_mutex_unlock(&event->mutex);
+
+  return 0;
+}
+
+static int show_rle(struct SharedEvent *event, const struct ems_output *out) {
+  char *buffer = malloc(rle_row_bound(event->cols));
+
+  if (buffer == NULL) {
+    fprintf(stderr, "Error allocating memory for event output\n");
+    return 1;
+  }
+
+  char header[2 * 20 + 2];
+  int ret = out->write(out->context, header, rle_format_header(header, event->rows, event->cols));
+
+  unsigned int *seats = at(event->seats);
+
+  for (size_t i = 0; i < event->rows && ret == 0; i++) {
+    access_delay();
+    size_t length = rle_format_row(buffer, i + 1, &seats[i * event->cols], event->cols);
+
+    if (length > 0) {
+      ret = out->write(out->context, buffer, length);
+    }
+  }
+
+  free(buffer);
+  return ret;
+}
+
+/// Prints an event a row at a time, so that each row takes a single write.
+static int show_plain(struct SharedEvent *event, const struct ems_output *out) {
+  // Up to 10 digits and a separator per seat, and the terminator of the last one.
+  char *buffer = malloc(event->cols * 11 + 1);
+
+  if (buffer == NULL) {
+    fprintf(stderr, "Error allocating memory for event output\n");
+    return 1;
+  }
+
+  unsigned int *seats = at(event->seats);
+  int ret = 0;
+
+  for (size_t i = 0; i < event->rows && ret == 0; i++) {
+    size_t length = 0;
+
+    for (size_t j = 0; j < event->cols; j++) {
+      access_delay();
+      length += (size_t)sprintf(buffer + length, j + 1 < event->cols ? "%u " : "%u", seats[i * event->cols + j]);
+    }
+
+    buffer[length++] = '\n';
+    ret = out->write(out->context, buffer, length);
+  }
+
+  free(buffer);
+  return ret;
+}
+
+int shared_show(unsigned int event_id, int out_fd, int rle) {
+  if (base == NULL) {
+    fprintf(stderr, "Shared state must be initialized\n");
+    return 1;
+  }
+
+  struct SharedEvent *event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    fprintf(stderr, "Event not found\n");
+    return 1;
+  }
+
+  if (lock_event(event) != 0) {
+    return 1;
+  }
+
+  struct ems_output out = {ems_write_fd, &out_fd, rle};
+  int ret = rle ? show_rle(event, &out) : show_plain(event, &out);
+
+  pthread_mutex_unlock(&event->mutex);
+
+  if (ret != 0) {
+    fprintf(stderr, "Error writing event output\n");
+  }
+
+  return ret;
+}
+
+int shared_list_events(int out_fd) {
+  if (base == NULL) {
+    fprintf(stderr, "Shared state must be initialized\n");
+    return 1;
+  }
+
+  // Events are only ever appended, so LIST prints the events created until it started.
+  shm_off offset = atomic_load_explicit(&header()->head, memory_order_acquire);
+
+  struct ems_output out = {ems_write_fd, &out_fd, 0};
+  int ret = 0;
+
+  if (offset == 0) {
+    ret = out.write(out.context, "No events\n", strlen("No events\n"));
+  }
+
+  while (offset != 0 && ret == 0) {
+    struct SharedEvent *event = at(offset);
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "Event: %u\n", event->id);
+    ret = out.write(out.context, buffer, (size_t)length);
+    offset = atomic_load_explicit(&event->next, memory_order_acquire);
+  }
+
+  return ret;
+}
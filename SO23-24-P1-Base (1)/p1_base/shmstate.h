@@ -0,0 +1,55 @@
+#ifndef EMS_SHMSTATE_H
+#define EMS_SHMSTATE_H
+
+#include <stddef.h>
+
+// Process-shared EMS state: the event table, the event headers and the seat arrays live in one
+// POSIX shared-memory segment that forked worker processes inherit. Everything in the segment is
+// addressed by offsets from its start and allocated by the segment's own allocator, so the layout
+// does not depend on where the segment is mapped. Locks are robust process-shared mutexes: when a
+// process dies holding one, the next process to take it repairs the half-done command and goes on.
+// Robust mutexes are Linux-only, so elsewhere a process that dies holding a lock blocks the others.
+
+/// Creates the shared state. Must be called before forking the worker processes.
+/// @param delay_ms State access delay in milliseconds.
+/// @param size Size of the shared-memory segment in bytes.
+/// @return 0 if the shared state was created successfully, 1 otherwise.
+int shared_init(unsigned int delay_ms, size_t size);
+
+/// Destroys the shared state. Must only be called once every worker process has exited.
+void shared_terminate();
+
+/// Creates a new event with the given id and dimensions in the shared state.
+/// @param event_id Id of the event to be created.
+/// @param num_rows Number of rows of the event to be created.
+/// @param num_cols Number of columns of the event to be created.
+/// @return 0 if the event was created successfully, 1 otherwise.
+int shared_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+
+/// Creates a new reservation for the given event in the shared state.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of seats to reserve.
+/// @param xs Array of rows of the seats to reserve.
+/// @param ys Array of columns of the seats to reserve.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int shared_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+
+/// Cancels a reservation of the given event in the shared state, freeing its seats.
+/// @param event_id Id of the event the reservation belongs to.
+/// @param reservation_id Id of the reservation to cancel.
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int shared_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Prints the given event of the shared state.
+/// @param event_id Id of the event to print.
+/// @param out_fd File descriptor to print the event to.
+/// @param rle Whether to print the event run-length encoded.
+/// @return 0 if the event was printed successfully, 1 otherwise.
+int shared_show(unsigned int event_id, int out_fd, int rle);
+
+/// Prints all the events of the shared state.
+/// @param out_fd File descriptor to print the events to.
+/// @return 0 if the events were printed successfully, 1 otherwise.
+int shared_list_events(int out_fd);
+
+#endif  // EMS_SHMSTATE_H
@@ -0,0 +1,172 @@
+#include "threadpool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+struct Batch {
+  work_fn fn;
+  void *arg;
+  size_t num_items;
+  size_t next_item;  /// First item not yet claimed by a thread.
+  size_t num_done;   /// Number of items that have finished running.
+  pthread_cond_t done_cond;
+  struct Batch *next;  /// Next batch with unclaimed items.
+};
+
+struct ThreadPool {
+  pthread_t *threads;
+  unsigned int num_threads;
+  int stopping;
+
+  struct Batch *batches_head;
+  struct Batch *batches_tail;
+
+  pthread_mutex_t lock;
+  pthread_cond_t work_cond;
+};
+
+/// Claims the next item of a batch, and removes the batch from the queue once all are claimed.
+/// Must be called with the pool lock held.
+static size_t claim_item(struct ThreadPool *pool, struct Batch *batch) {
+  size_t item = batch->next_item++;
+
+  if (batch->next_item == batch->num_items) {
+    // Callers claim items of their own batch, which need not be the first one in the queue.
+    struct Batch **link = &pool->batches_head;
+    struct Batch *previous = NULL;
+    while (*link != batch) {
+      previous = *link;
+      link = &previous->next;
+    }
+
+    *link = batch->next;
+    if (pool->batches_tail == batch) {
+      pool->batches_tail = previous;
+    }
+  }
+
+  return item;
+}
+
+/// Runs a claimed item and records that it finished. Must be called with the pool lock held.
+static void run_item(struct ThreadPool *pool, struct Batch *batch, size_t item) {
+  pthread_mutex_unlock(&pool->lock);
+  batch->fn(batch->arg, item);
+  pthread_mutex_lock(&pool->lock);
+
+  if (++batch->num_done == batch->num_items) {
+    pthread_cond_signal(&batch->done_cond);
+  }
+}
+
+static void *worker_main(void *arg) {
+  struct ThreadPool *pool = arg;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1) {
+    while (pool->batches_head == NULL && !pool->stopping) {
+      pthread_cond_wait(&pool->work_cond, &pool->lock);
+    }
+
+    if (pool->batches_head == NULL) {
+      break;
+    }
+
+    struct Batch *batch = pool->batches_head;
+    run_item(pool, batch, claim_item(pool, batch));
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+struct ThreadPool *threadpool_create(unsigned int count) {
+  struct ThreadPool *pool = malloc(sizeof(struct ThreadPool));
+  pthread_t *threads = malloc((count ? count : 1) * sizeof(pthread_t));
+
+  if (pool == NULL || threads == NULL) {
+    fprintf(stderr, "Error allocating memory for thread pool\n");
+    free(pool);
+    free(threads);
+    return NULL;
+  }
+
+  pool->threads = threads;
+  pool->num_threads = 0;
+  pool->stopping = 0;
+  pool->batches_head = NULL;
+  pool->batches_tail = NULL;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+
+  for (; pool->num_threads < count; pool->num_threads++) {
+    if (pthread_create(&pool->threads[pool->num_threads], NULL, worker_main, pool) != 0) {
+      fprintf(stderr, "Failed to create pool thread\n");
+      threadpool_destroy(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+void threadpool_destroy(struct ThreadPool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stopping = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (unsigned int i = 0; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool->threads);
+  free(pool);
+}
+
+void threadpool_for(struct ThreadPool *pool, work_fn fn, void *arg, size_t num_items) {
+  if (pool == NULL) {
+    for (size_t item = 0; item < num_items; item++) {
+      fn(arg, item);
+    }
+    return;
+  }
+
+  if (num_items == 0) {
+    return;
+  }
+
+  struct Batch batch = {fn, arg, num_items, 0, 0, PTHREAD_COND_INITIALIZER, NULL};
+
+  pthread_mutex_lock(&pool->lock);
+
+  if (pool->batches_tail == NULL) {
+    pool->batches_head = &batch;
+  } else {
+    pool->batches_tail->next = &batch;
+  }
+  pool->batches_tail = &batch;
+
+  if (num_items > 1) {
+    pthread_cond_broadcast(&pool->work_cond);
+  }
+
+  // The caller works on its own batch too, so it completes even without pool threads.
+  while (batch.next_item < batch.num_items) {
+    run_item(pool, &batch, claim_item(pool, &batch));
+  }
+
+  while (batch.num_done < batch.num_items) {
+    pthread_cond_wait(&batch.done_cond, &pool->lock);
+  }
+
+  pthread_mutex_unlock(&pool->lock);
+  pthread_cond_destroy(&batch.done_cond);
+}
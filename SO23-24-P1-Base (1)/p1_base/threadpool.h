@@ -0,0 +1,30 @@
+#ifndef EMS_THREADPOOL_H
+#define EMS_THREADPOOL_H
+
+#include <stddef.h>
+
+// Fork-join thread pool: a batch of independent work items is split between the pool threads and
+// the calling thread, which returns once every item has run. Several threads may run batches on a
+// pool at the same time, and a batch still completes if the pool has no threads.
+
+struct ThreadPool;
+
+typedef void (*work_fn)(void *arg, size_t item);
+
+/// Creates a pool and starts its threads.
+/// @param num_threads Number of threads helping the callers of threadpool_for, may be 0.
+/// @return Pointer to the pool, NULL on failure.
+struct ThreadPool *threadpool_create(unsigned int num_threads);
+
+/// Stops the threads of a pool and destroys it. Must only be called when no batch is running on it.
+/// @param pool Pool to be destroyed.
+void threadpool_destroy(struct ThreadPool *pool);
+
+/// Runs fn(arg, item) for every item in [0, num_items) and waits for all of them.
+/// @param pool Pool whose threads help run the items, or NULL to run them on the calling thread.
+/// @param fn Function to run for each item.
+/// @param arg Argument shared by every item.
+/// @param num_items Number of items.
+void threadpool_for(struct ThreadPool *pool, work_fn fn, void *arg, size_t num_items);
+
+#endif  // EMS_THREADPOOL_H